@@ -0,0 +1,104 @@
+#ifndef ANCHORCONFIG_H
+#define ANCHORCONFIG_H
+
+namespace my {
+
+    /*
+    Which Mediapipe face detector runs:
+        Short: faces within ~2 meters (face_detection_short.tflite, 128x128)
+        Full: faces within ~5 meters (face_detection_full_range.tflite, 192x192)
+    */
+    enum class DetectorRange {
+        Short,
+        Full
+    };
+
+    /*
+    Anchor layout of Mediapipe short-range face detector (face_detection_short.tflite).
+    2 x 16 x 16 and 6 x 8 x 8 --> 896
+    */
+    struct ShortRangeAnchorConfig {
+        static constexpr const char* modelFile = "face_detection_short.tflite";
+        static constexpr int inputSize = 128;
+        static constexpr int numLayers = 2;
+        static constexpr int gridSizes[numLayers] = {16, 8};
+        static constexpr int anchorsPerCell[numLayers] = {2, 6};
+        static constexpr int numBoxes = 896;
+
+        // The offset for the center of anchors.
+        static constexpr float offsetX = 0.5f;
+        static constexpr float offsetY = 0.5f;
+    };
+
+    /*
+    Anchor layout of Mediapipe full-range face detector (face_detection_full_range.tflite).
+    1 x 48 x 48 --> 2304
+    */
+    struct FullRangeAnchorConfig {
+        static constexpr const char* modelFile = "face_detection_full_range.tflite";
+        static constexpr int inputSize = 192;
+        static constexpr int numLayers = 1;
+        static constexpr int gridSizes[numLayers] = {48};
+        static constexpr int anchorsPerCell[numLayers] = {1};
+        static constexpr int numBoxes = 2304;
+
+        static constexpr float offsetX = 0.5f;
+        static constexpr float offsetY = 0.5f;
+    };
+
+    /*
+    Anchor centers in structure-of-arrays layout.
+    (Note: Mediapipe face detectors use fixed anchor size 1x1, so only centers are stored)
+    */
+    template <class Config>
+    struct AnchorTable {
+        float cx[Config::numBoxes];
+        float cy[Config::numBoxes];
+    };
+
+    /*
+    Number of anchors described by the layers of Config
+    */
+    template <class Config>
+    constexpr int countAnchors() {
+        int count = 0;
+        for (int i = 0; i < Config::numLayers; ++i) {
+            count += Config::gridSizes[i] * Config::gridSizes[i] * Config::anchorsPerCell[i];
+        }
+        return count;
+    }
+
+    /*
+    Generate the anchor grid of Config at compile time
+    */
+    template <class Config>
+    constexpr AnchorTable<Config> generateAnchors() {
+        AnchorTable<Config> table{};
+        int k = 0;
+        for (int i = 0; i < Config::numLayers; ++i) {
+            int size = Config::gridSizes[i];
+
+            for (int y = 0; y < size; ++y) {
+                for (int x = 0; x < size; ++x) {
+                    for (int a = 0; a < Config::anchorsPerCell[i]; ++a) {
+                        table.cx[k] = (x + Config::offsetX) / size;
+                        table.cy[k] = (y + Config::offsetY) / size;
+                        ++k;
+                    }
+                }
+            }
+        }
+        return table;
+    }
+
+    /*
+    The anchors of Config, generated once at compile time.
+    */
+    template <class Config>
+    struct Anchors {
+        static_assert(countAnchors<Config>() == Config::numBoxes, "Anchor layers do not match numBoxes");
+        static constexpr AnchorTable<Config> table = generateAnchors<Config>();
+    };
+}
+
+#endif // ANCHORCONFIG_H
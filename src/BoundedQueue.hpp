@@ -0,0 +1,111 @@
+#ifndef BOUNDEDQUEUE_H
+#define BOUNDEDQUEUE_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+namespace my {
+
+    /*
+    A blocking FIFO queue with a maximum capacity, used between pipeline stages.
+    push() blocks while the queue is full (backpressure), pop() blocks while it is empty.
+    After close(), push() fails and pop() drains the remaining items then fails.
+    This class is thread-safe and non-copyable.
+    */
+    template <class T>
+    class BoundedQueue {
+        public:
+            BoundedQueue(size_t capacity): m_capacity(std::max(capacity, (size_t)1)), m_closed(false) {}
+            BoundedQueue(const BoundedQueue& other) = delete;
+            BoundedQueue& operator=(const BoundedQueue& other) = delete;
+            ~BoundedQueue() = default;
+
+            /*
+            Wait for a free slot and append item. Return false if the queue is closed.
+            */
+            bool push(T item) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_notFull.wait(lock, [this]() {return m_closed || m_items.size() < m_capacity;});
+                if (m_closed) return false;
+
+                m_items.push_back(std::move(item));
+                lock.unlock();
+                m_notEmpty.notify_one();
+                return true;
+            }
+
+            /*
+            Append item only if there is a free slot.
+            */
+            bool tryPush(T& item) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_closed || m_items.size() >= m_capacity) return false;
+
+                m_items.push_back(std::move(item));
+                lock.unlock();
+                m_notEmpty.notify_one();
+                return true;
+            }
+
+            /*
+            Wait for an item. Return false if the queue is closed and empty.
+            */
+            bool pop(T& item) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_notEmpty.wait(lock, [this]() {return m_closed || !m_items.empty();});
+                if (m_items.empty()) return false;
+
+                item = std::move(m_items.front());
+                m_items.pop_front();
+                lock.unlock();
+                m_notFull.notify_one();
+                return true;
+            }
+
+            /*
+            Get an item only if one is available.
+            */
+            bool tryPop(T& item) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (m_items.empty()) return false;
+
+                item = std::move(m_items.front());
+                m_items.pop_front();
+                lock.unlock();
+                m_notFull.notify_one();
+                return true;
+            }
+
+            void close() {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_closed = true;
+                }
+                m_notFull.notify_all();
+                m_notEmpty.notify_all();
+            }
+
+            size_t size() const {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                return m_items.size();
+            }
+
+            size_t capacity() const {
+                return m_capacity;
+            }
+
+
+        private:
+            const size_t m_capacity;
+            std::deque<T> m_items;
+            bool m_closed;
+
+            mutable std::mutex m_mutex;
+            std::condition_variable m_notFull;
+            std::condition_variable m_notEmpty;
+    };
+}
+
+#endif // BOUNDEDQUEUE_H
@@ -1,61 +1,390 @@
 #include "DetectionPostProcess.hpp"
+#include "Metrics.hpp"
 #include <iostream>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <type_traits>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define USE_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define USE_SSE2 1
+#endif
 
 /*
-Helper function
+Helper functions
 */
-std::vector<cv::Rect2f> generateAnchors(my::AnchorOptions options) {
-    std::vector<cv::Rect2f> anchors;
-    for (int i = 0; i < NUM_SIZES; ++i) {
-        auto size = options.sizes[i];
-        auto numLayer = options.numLayers[i];
-
-        for (auto y = 0; y < size; ++y) {
-            for (auto x = 0; x < size; ++x) {
-                float x_center = (x + options.offsetX) * 1.f / size;
-                float y_center = (y + options.offsetY) * 1.f / size;
-                float w = 1.f;
-                float h = 1.f;
-                anchors.insert(anchors.end(), numLayer, cv::Rect2f(x_center - w/2.f, y_center - h/2.f, w, h));
-            }
+int findHighestScore(const float* scores, int n) {
+    int i = 0;
+    float best = -INFINITY;
+
+#if USE_AVX2
+    __m256 vbest8 = _mm256_set1_ps(-INFINITY);
+    for (; i + 8 <= n; i += 8) {
+        vbest8 = _mm256_max_ps(vbest8, _mm256_loadu_ps(scores + i));
+    }
+    __m128 vbest = _mm_max_ps(_mm256_castps256_ps128(vbest8), _mm256_extractf128_ps(vbest8, 1));
+#elif USE_SSE2
+    __m128 vbest = _mm_set1_ps(-INFINITY);
+    for (; i + 4 <= n; i += 4) {
+        vbest = _mm_max_ps(vbest, _mm_loadu_ps(scores + i));
+    }
+#endif
+#if USE_AVX2 || USE_SSE2
+    vbest = _mm_max_ps(vbest, _mm_shuffle_ps(vbest, vbest, _MM_SHUFFLE(1, 0, 3, 2)));
+    vbest = _mm_max_ps(vbest, _mm_shuffle_ps(vbest, vbest, _MM_SHUFFLE(2, 3, 0, 1)));
+    best = _mm_cvtss_f32(vbest);
+#endif
+    for (; i < n; ++i) {
+        best = std::max(best, scores[i]);
+    }
+
+    /*
+    First index holding the maximum, as the scalar scan would pick
+    */
+    for (i = 0; i < n; ++i) {
+        if (scores[i] == best) return i;
+    }
+    return -1;
+}
+
+
+int findScoresAbove(const float* scores, int n, float threshold, std::vector<int>& indices) {
+    indices.clear();
+    int i = 0;
+
+#if USE_AVX2
+    const __m256 vthreshold8 = _mm256_set1_ps(threshold);
+    for (; i + 8 <= n; i += 8) {
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(scores + i), vthreshold8, _CMP_GT_OQ));
+        for (int bit = 0; mask; ++bit, mask >>= 1) {
+            if (mask & 1) indices.push_back(i + bit);
         }
     }
-    return anchors;
+#endif
+#if USE_SSE2
+    const __m128 vthreshold = _mm_set1_ps(threshold);
+    for (; i + 4 <= n; i += 4) {
+        int mask = _mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(scores + i), vthreshold));
+        for (int bit = 0; mask; ++bit, mask >>= 1) {
+            if (mask & 1) indices.push_back(i + bit);
+        }
+    }
+#endif
+    for (; i < n; ++i) {
+        if (scores[i] > threshold) indices.push_back(i);
+    }
+    return (int)indices.size();
 }
 
 
-my::DetectionPostProcess::DetectionPostProcess() :
-    m_anchors(generateAnchors(AnchorOptions())) {}
+/*
+Quantized scores are compared as signed bytes: uint8 values are biased by 0x80 to keep their order
+*/
+template <class T>
+constexpr uint8_t getSignedBias() {
+    return std::is_signed<T>::value ? 0x00 : 0x80;
+}
 
 
-cv::Rect2f my::DetectionPostProcess::decodeBox
-(const std::vector<float>& rawBoxes, int index) const {
-    auto anchor = m_anchors[index];
-    auto center = (anchor.tl() + anchor.br()) * 0.5;
-    
-    auto boxOffset = index * NUM_COORD;
-    float cx = rawBoxes[boxOffset];
-    float cy = rawBoxes[boxOffset + 1];
-    float w = rawBoxes[boxOffset + 2];
-    float h = rawBoxes[boxOffset + 3];
+template <class T>
+int findHighestQuantizedScore(const T* scores, int n) {
+    int i = 0;
+    int best = std::numeric_limits<T>::lowest();
 
-    cx = cx / DETECTION_SIZE * anchor.width + center.x;
-    cy = cy / DETECTION_SIZE * anchor.height + center.y;
-    w = w / DETECTION_SIZE * anchor.width;
-    h = h / DETECTION_SIZE * anchor.height;
+#if USE_SSE2
+    /*
+    _mm_max_epu8 compares unsigned bytes: int8 values are biased by 0x80 instead
+    */
+    const __m128i unsignedBias = _mm_set1_epi8((char)(getSignedBias<T>() ^ 0x80));
+    __m128i vbest = _mm_setzero_si128();
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(scores + i)), unsignedBias);
+        vbest = _mm_max_epu8(vbest, v);
+    }
+    alignas(16) uint8_t lanes[16];
+    _mm_store_si128((__m128i*)lanes, _mm_xor_si128(vbest, unsignedBias));
+    for (uint8_t lane : lanes) best = std::max(best, (int)(T)lane);
+#endif
+    for (; i < n; ++i) {
+        best = std::max(best, (int)scores[i]);
+    }
 
-    return cv::Rect2f(cx - w/2, cy - h/2, w, h);
+    for (i = 0; i < n; ++i) {
+        if (scores[i] == best) return i;
+    }
+    return -1;
 }
 
 
-my::Detection my::DetectionPostProcess::getHighestScoreDetection
-(const std::vector<float>& rawBoxes, const std::vector<float>& scores) const {
-    my::Detection detection;
-    for (int i = 0; i < NUM_BOXES; i++) {
-        if (scores[i] > std::max(MIN_THRESHOLD, detection.score)) {
-            auto data = decodeBox(rawBoxes, i);
-            detection = my::Detection(scores[i], CLASS_ID, data);
+template <class T>
+int findQuantizedScoresAbove(const T* scores, int n, int threshold, std::vector<int>& indices) {
+    indices.clear();
+    if (threshold >= std::numeric_limits<T>::max()) return 0;
+    threshold = std::max(threshold, (int)std::numeric_limits<T>::lowest() - 1);
+    int i = 0;
+
+#if USE_SSE2
+    if (threshold >= std::numeric_limits<T>::lowest()) {
+        const __m128i bias = _mm_set1_epi8((char)getSignedBias<T>());
+        const __m128i vthreshold = _mm_set1_epi8((char)((uint8_t)threshold ^ getSignedBias<T>()));
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(scores + i)), bias);
+            int mask = _mm_movemask_epi8(_mm_cmpgt_epi8(v, vthreshold));
+            for (int bit = 0; mask; ++bit, mask >>= 1) {
+                if (mask & 1) indices.push_back(i + bit);
+            }
         }
     }
+#endif
+    for (; i < n; ++i) {
+        if (scores[i] > threshold) indices.push_back(i);
+    }
+    return (int)indices.size();
+}
+
+
+cv::Rect2f decodeAnchorBox(const float* raw, float anchorCx, float anchorCy, float scale) {
+    /*
+    (cx, cy, w, h) = raw * scale + (anchorCx, anchorCy, 0, 0), anchor size is 1x1
+    */
+#if USE_SSE2
+    __m128 box = _mm_add_ps(
+        _mm_mul_ps(_mm_loadu_ps(raw), _mm_set1_ps(scale)),
+        _mm_setr_ps(anchorCx, anchorCy, 0.f, 0.f));
+    __m128 half = _mm_mul_ps(_mm_movehl_ps(box, box), _mm_set1_ps(0.5f));
+    __m128 tl = _mm_sub_ps(box, half);
+
+    float out[4];
+    _mm_storeu_ps(out, _mm_movelh_ps(tl, _mm_movehl_ps(box, box)));
+    return cv::Rect2f(out[0], out[1], out[2], out[3]);
+#else
+    float cx = raw[0] * scale + anchorCx;
+    float cy = raw[1] * scale + anchorCy;
+    float w = raw[2] * scale;
+    float h = raw[3] * scale;
+    return cv::Rect2f(cx - w/2, cy - h/2, w, h);
+#endif
+}
+
+
+/*
+(x, y) of each keypoint = raw * scale + (anchorCx, anchorCy), two keypoints per SSE register
+*/
+void decodeAnchorKeypoints(const float* raw, float anchorCx, float anchorCy, float scale, cv::Point2f* keypoints) {
+    static_assert(sizeof(cv::Point2f) == 2 * sizeof(float), "cv::Point2f must be two packed floats");
+    float* out = &keypoints[0].x;
+    int i = 0;
+
+#if USE_SSE2
+    const __m128 vscale = _mm_set1_ps(scale);
+    const __m128 vanchor = _mm_setr_ps(anchorCx, anchorCy, anchorCx, anchorCy);
+    for (; i + 4 <= NUM_KEYPOINTS * 2; i += 4) {
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(raw + i), vscale), vanchor));
+    }
+#endif
+    for (; i < NUM_KEYPOINTS * 2; i += 2) {
+        out[i] = raw[i] * scale + anchorCx;
+        out[i + 1] = raw[i + 1] * scale + anchorCy;
+    }
+}
+
+
+float intersectionOverUnion(const cv::Rect2f& a, const cv::Rect2f& b) {
+    float intersection = (a & b).area();
+    if (intersection <= 0.f) return 0.f;
+    return intersection / (a.area() + b.area() - intersection);
+}
+
+
+int getPostprocessStage() {
+    static const int stage = my::Metrics::getInstance().registerStage("detection.postprocess");
+    return stage;
+}
+
+
+template <class Config>
+my::Detection my::DetectionPostProcess<Config>::decodeDetection
+(const TensorView<float>& rawBoxes, int index, float score) const {
+    const auto& anchors = Anchors<Config>::table;
+    const float* raw = rawBoxes.data + index * NUM_COORD;
+    constexpr float scale = 1.f / Config::inputSize;
+
+    Detection detection(score, CLASS_ID, decodeAnchorBox(raw, anchors.cx[index], anchors.cy[index], scale));
+    decodeAnchorKeypoints(raw + 4, anchors.cx[index], anchors.cy[index], scale, detection.keypoints.data());
     return detection;
-}
\ No newline at end of file
+}
+
+
+template <class Config>
+my::Detection my::DetectionPostProcess<Config>::getHighestScoreDetection
+(const TensorView<float>& rawBoxes, const TensorView<float>& scores) const {
+    METRICS_SCOPE(getPostprocessStage());
+    int numBoxes = std::min((int)scores.size, Config::numBoxes);
+    int best = findHighestScore(scores.data, numBoxes);
+
+    if (best < 0 || scores[best] <= MIN_THRESHOLD)
+        return my::Detection();
+
+    return decodeDetection(rawBoxes, best, scores[best]);
+}
+
+
+template <class Config>
+std::vector<my::Detection> my::DetectionPostProcess<Config>::getDetections
+(const TensorView<float>& rawBoxes, const TensorView<float>& scores, int maxDetections) const {
+    std::vector<Detection> detections;
+    getDetections(rawBoxes, scores, maxDetections, detections);
+    return detections;
+}
+
+
+template <class Config>
+void my::DetectionPostProcess<Config>::getDetections(const TensorView<float>& rawBoxes, const TensorView<float>& scores, 
+                                                     int maxDetections, std::vector<Detection>& detections) const {
+    METRICS_SCOPE(getPostprocessStage());
+    auto& candidates = m_candidates;
+    int numBoxes = std::min((int)scores.size, Config::numBoxes);
+    findScoresAbove(scores.data, numBoxes, MIN_THRESHOLD, candidates);
+
+    std::sort(candidates.begin(), candidates.end(), 
+        [&scores](int a, int b) {return scores[a] > scores[b];});
+
+    m_candidateScores.resize(candidates.size());
+    for (int i = 0; i < (int)candidates.size(); ++i) {
+        m_candidateScores[i] = scores[candidates[i]];
+    }
+    mergeCandidates(rawBoxes, maxDetections, detections);
+}
+
+
+template <class Config>
+template <class T>
+my::Detection my::DetectionPostProcess<Config>::getHighestScoreDetection
+(const TensorView<float>& rawBoxes, const QuantizedView<T>& scores) const {
+    METRICS_SCOPE(getPostprocessStage());
+    int numBoxes = std::min((int)scores.values.size, Config::numBoxes);
+    int best = findHighestQuantizedScore(scores.values.data, numBoxes);
+
+    if (best < 0 || scores[best] <= MIN_THRESHOLD)
+        return my::Detection();
+
+    return decodeDetection(rawBoxes, best, scores[best]);
+}
+
+
+template <class Config>
+template <class T>
+std::vector<my::Detection> my::DetectionPostProcess<Config>::getDetections
+(const TensorView<float>& rawBoxes, const QuantizedView<T>& scores, int maxDetections) const {
+    std::vector<Detection> detections;
+    getDetections(rawBoxes, scores, maxDetections, detections);
+    return detections;
+}
+
+
+template <class Config>
+template <class T>
+void my::DetectionPostProcess<Config>::getDetections(const TensorView<float>& rawBoxes, const QuantizedView<T>& scores, 
+                                                     int maxDetections, std::vector<Detection>& detections) const {
+    METRICS_SCOPE(getPostprocessStage());
+    detections.clear();
+    if (scores.params.scale <= 0.f) 
+        return;
+
+    /*
+    score > MIN_THRESHOLD <=> q > MIN_THRESHOLD / scale + zeroPoint <=> q > floor(...) as q is an integer
+    */
+    int threshold = (int)std::floor(MIN_THRESHOLD / scores.params.scale + scores.params.zeroPoint);
+    auto& candidates = m_candidates;
+    int numBoxes = std::min((int)scores.values.size, Config::numBoxes);
+    findQuantizedScoresAbove(scores.values.data, numBoxes, threshold, candidates);
+
+    std::sort(candidates.begin(), candidates.end(), 
+        [&scores](int a, int b) {return scores.values[a] > scores.values[b];});
+
+    m_candidateScores.resize(candidates.size());
+    for (int i = 0; i < (int)candidates.size(); ++i) {
+        m_candidateScores[i] = scores[candidates[i]];
+    }
+    mergeCandidates(rawBoxes, maxDetections, detections);
+}
+
+
+template <class Config>
+void my::DetectionPostProcess<Config>::mergeCandidates(const TensorView<float>& rawBoxes, int maxDetections, 
+                                                       std::vector<Detection>& detections) const {
+    const auto& candidates = m_candidates;
+    const auto& candidateScores = m_candidateScores;
+    auto& decoded = m_decoded;
+    decoded.resize(candidates.size());
+    for (int i = 0; i < (int)candidates.size(); ++i) {
+        decoded[i] = decodeDetection(rawBoxes, candidates[i], candidateScores[i]);
+    }
+
+    /*
+    Weighted NMS: every box overlapping the best remaining one is merged into it,
+    weighted by its confidence (scores are logits).
+    */
+    detections.clear();
+    auto& suppressed = m_suppressed;
+    suppressed.assign(candidates.size(), false);
+
+    for (int i = 0; i < (int)candidates.size() && (int)detections.size() < maxDetections; ++i) {
+        if (suppressed[i]) continue;
+
+        float sumWeight = 0.f;
+        float x1 = 0.f, y1 = 0.f, x2 = 0.f, y2 = 0.f;
+        std::array<cv::Point2f, NUM_KEYPOINTS> keypoints = {};
+
+        for (int j = i; j < (int)candidates.size(); ++j) {
+            const auto& box = decoded[j].roi;
+            if (suppressed[j] || intersectionOverUnion(decoded[i].roi, box) <= NMS_THRESHOLD) 
+                continue;
+
+            float weight = 1.f / (1.f + std::exp(-candidateScores[j]));
+            x1 += box.x * weight;
+            y1 += box.y * weight;
+            x2 += box.br().x * weight;
+            y2 += box.br().y * weight;
+            for (int k = 0; k < NUM_KEYPOINTS; ++k) {
+                keypoints[k] += decoded[j].keypoints[k] * weight;
+            }
+            sumWeight += weight;
+            suppressed[j] = true;
+        }
+
+        cv::Rect2f merged(x1 / sumWeight, y1 / sumWeight, 
+            (x2 - x1) / sumWeight, (y2 - y1) / sumWeight);
+        detections.emplace_back(candidateScores[i], CLASS_ID, merged);
+        for (int k = 0; k < NUM_KEYPOINTS; ++k) {
+            detections.back().keypoints[k] = keypoints[k] * (1.f / sumWeight);
+        }
+    }
+}
+
+
+/*
+The decoders of both detectors, with their quantized variants
+*/
+#define INSTANTIATE_POST_PROCESS(Config) \
+    template class my::DetectionPostProcess<Config>; \
+    template my::Detection my::DetectionPostProcess<Config>::getHighestScoreDetection<uint8_t> \
+    (const TensorView<float>&, const QuantizedView<uint8_t>&) const; \
+    template my::Detection my::DetectionPostProcess<Config>::getHighestScoreDetection<int8_t> \
+    (const TensorView<float>&, const QuantizedView<int8_t>&) const; \
+    template std::vector<my::Detection> my::DetectionPostProcess<Config>::getDetections<uint8_t> \
+    (const TensorView<float>&, const QuantizedView<uint8_t>&, int) const; \
+    template std::vector<my::Detection> my::DetectionPostProcess<Config>::getDetections<int8_t> \
+    (const TensorView<float>&, const QuantizedView<int8_t>&, int) const; \
+    template void my::DetectionPostProcess<Config>::getDetections<uint8_t> \
+    (const TensorView<float>&, const QuantizedView<uint8_t>&, int, std::vector<Detection>&) const; \
+    template void my::DetectionPostProcess<Config>::getDetections<int8_t> \
+    (const TensorView<float>&, const QuantizedView<int8_t>&, int, std::vector<Detection>&) const;
+
+INSTANTIATE_POST_PROCESS(my::ShortRangeAnchorConfig)
+INSTANTIATE_POST_PROCESS(my::FullRangeAnchorConfig)
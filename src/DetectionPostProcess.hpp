@@ -2,57 +2,120 @@
 #define DETECTIONPOSTPROCESS_H
 
 #include <algorithm>
+#include <array>
 #include <functional>
 #include <vector>
 #include <string>
 #include "opencv2/core.hpp"
+#include "ModelLoader.hpp"
+#include "AnchorConfig.hpp"
 
 #define CLASS_ID        0
 #define MIN_THRESHOLD   0.75f
-#define DETECTION_SIZE  128
-#define NUM_BOXES       896
 #define NUM_COORD       16
-#define NUM_SIZES       2
+#define NUM_KEYPOINTS   6
+#define NMS_THRESHOLD   0.3f
 
 namespace my {
 
-    struct AnchorOptions {
-        // 2 x 16 x 16 and 6 x 8 x 8 --> 896
-        const int sizes[NUM_SIZES] = {16, 8};
-        const int numLayers[NUM_SIZES] = {2, 6};
 
-        // The offset for the center of anchors.
-        const float offsetX = 0.5f;
-        const float offsetY = 0.5f;
+    /*
+    Keypoints regressed by Mediapipe Face Detection after the box, in this order.
+    Left and right are those of the person (the left eye is on the right of the image).
+    */
+    enum class FaceKeypoint {
+        RightEye = 0,
+        LeftEye,
+        NoseTip,
+        MouthCenter,
+        RightEarTragion,
+        LeftEarTragion
     };
 
-
+    /*
+    A detected face. The box and keypoints are in local shape [0..1].
+    */
     struct Detection {
         cv::Rect2f roi;
         float score;
         int classId;
+        std::array<cv::Point2f, NUM_KEYPOINTS> keypoints;
 
-        Detection() : score(), classId(-1), roi() {}
+        Detection() : score(), classId(-1), roi(), keypoints() {}
         Detection(float score, int classId, cv::Rect2f roi) :
-            score(score), classId(classId), roi(roi) {}
+            score(score), classId(classId), roi(roi), keypoints() {}
         ~Detection() = default;
+
+        const cv::Point2f& getKeypoint(FaceKeypoint keypoint) const { return keypoints[(int)keypoint]; }
     };
 
     /*
     A helper class converts the output from Mediapipe Face Detection to Face box.
+    Config describes the detector (ShortRangeAnchorConfig or FullRangeAnchorConfig, see AnchorConfig.hpp):
+    its anchors are generated at compile time and the number of boxes and input size are constants of
+    each decoder. The score scan / box decoding use SSE or AVX2 when available (scalar fallback otherwise).
+    Candidates are kept in buffers reused from call to call, so an instance must not be
+    used by two threads at the same time.
     */
+    template <class Config>
     class DetectionPostProcess {
         public:
-            DetectionPostProcess();
+            DetectionPostProcess() = default;
             ~DetectionPostProcess() = default;
             Detection getHighestScoreDetection
-            (const std::vector<float>& rawBoxes, const std::vector<float>& scores) const;
+            (const TensorView<float>& rawBoxes, const TensorView<float>& scores) const;
+
+            /*
+            Get at most maxDetections faces, sorted by score.
+            Overlapping boxes are merged with weighted non-max suppression (as in Mediapipe).
+            */
+            std::vector<Detection> getDetections
+            (const TensorView<float>& rawBoxes, const TensorView<float>& scores, int maxDetections) const;
+
+            /*
+            Same as above, written to detections (its capacity is reused: no allocation once warm)
+            */
+            void getDetections(const TensorView<float>& rawBoxes, const TensorView<float>& scores, 
+                               int maxDetections, std::vector<Detection>& detections) const;
+
+            /*
+            Same as above for uint8/int8 scores of quantized models.
+            Scores are thresholded in the quantized domain, only candidates are dequantized.
+            */
+            template <class T>
+            Detection getHighestScoreDetection
+            (const TensorView<float>& rawBoxes, const QuantizedView<T>& scores) const;
+
+            template <class T>
+            std::vector<Detection> getDetections
+            (const TensorView<float>& rawBoxes, const QuantizedView<T>& scores, int maxDetections) const;
+
+            template <class T>
+            void getDetections(const TensorView<float>& rawBoxes, const QuantizedView<T>& scores, 
+                               int maxDetections, std::vector<Detection>& detections) const;
 
         private:
-            cv::Rect2f decodeBox(const std::vector<float>& rawBoxes, int index) const;
+            /*
+            Decode the box and keypoints of anchor index
+            */
+            Detection decodeDetection(const TensorView<float>& rawBoxes, int index, float score) const;
+
+            /*
+            Weighted NMS of m_candidates (keypoints are merged the same way), 
+            candidates must be sorted by decreasing score and their scores in m_candidateScores
+            */
+            void mergeCandidates(const TensorView<float>& rawBoxes, int maxDetections, 
+                                 std::vector<Detection>& detections) const;
+
 
         private:
-            std::vector<cv::Rect2f> m_anchors;
+            /*
+            Buffers of getDetections(), reused from call to call
+            */
+            mutable std::vector<int> m_candidates;
+            mutable std::vector<float> m_candidateScores;
+            mutable std::vector<Detection> m_decoded;
+            mutable std::vector<bool> m_suppressed;
     };
 }
 
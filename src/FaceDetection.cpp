@@ -1,33 +1,80 @@
 #include "FaceDetection.hpp"
+#include "Metrics.hpp"
 
+#include <cmath>
+#include <iostream>
 
-my::FaceDetection::FaceDetection(std::string modelDir) :
-    my::ModelLoader(modelDir + std::string("/face_detection_short.tflite")) 
-{}
+/*
+Eye Roi side over the distance between the eye keypoints
+*/
+#define EYE_ROI_SCALE   0.6f
+
+/*
+Helper functions
+*/
+int getCropStage() {
+    static const int stage = my::Metrics::getInstance().registerStage("crop");
+    return stage;
+}
+
+
+cv::Point2f toImagePoint(const cv::Point2f& point, const cv::Size& imageSize) {
+    return cv::Point2f(point.x * imageSize.width, point.y * imageSize.height);
+}
+
+
+std::string getDetectorPath(const std::string& modelDir, my::DetectorRange range) {
+    const char* modelFile = range == my::DetectorRange::Full ? 
+        my::FullRangeAnchorConfig::modelFile : my::ShortRangeAnchorConfig::modelFile;
+    return modelDir + "/" + modelFile;
+}
+
+
+my::FaceDetection::FaceDetection(std::string modelDir, const InterpreterOptions& options, DetectorRange range) :
+    my::ModelLoader(getDetectorPath(modelDir, range), options),
+    m_detectorRange(range),
+    m_maxFaces(1)
+{
+    /*
+    The decoder is specialized for the anchors of one detector
+    */
+    int inputSize = range == DetectorRange::Full ? FullRangeAnchorConfig::inputSize : ShortRangeAnchorConfig::inputSize;
+    if (getInputImageSize() != cv::Size(inputSize, inputSize)) {
+        std::cerr << getDetectorPath(modelDir, range) << " is not a " << inputSize << "x" << inputSize \
+        << " face detector." << std::endl;
+        std::exit(1);
+    }
+}
+
+
+my::DetectorRange my::FaceDetection::getDetectorRange() const {
+    return m_detectorRange;
+}
 
 
 void my::FaceDetection::loadImageToInput(const cv::Mat& in, int index) {
     m_originImage = in;
-    ModelLoader::loadImageToInput(in);
 }
 
 
 void my::FaceDetection::runInference() {
+    ModelLoader::loadImageToInput(m_originImage);
     ModelLoader::runInference();
 
-    auto regressor = getFaceRegressor();
-    auto classificator = getFaceClassificator();
-    auto detection = m_postProcessor.getHighestScoreDetection(regressor, classificator);
-
-    if (detection.classId != -1) {
-        /*
-        The detection is still in local shape [0..1]
-        */
-        m_roi = calculateRoiFromDetection(detection);
-    }
-    else {
-        m_roi = cv::Rect();
+    /*
+    Quantized scores are thresholded without dequantizing all of them
+    */
+    switch (getOutputType(1)) {
+        case kTfLiteUInt8:
+            detectFaces(getQuantizedOutputView<uint8_t>(1));
+            break;
+        case kTfLiteInt8:
+            detectFaces(getQuantizedOutputView<int8_t>(1));
+            break;
+        default:
+            detectFaces(getFaceClassificator());
     }
+    m_roi = m_rois.empty() ? cv::Rect() : m_rois[0];
 }
 
 
@@ -36,13 +83,18 @@ cv::Mat my::FaceDetection::getOriginalImage() const {
 }
 
 
-std::vector<float> my::FaceDetection::getFaceRegressor() const {
-    return ModelLoader::loadOutput(0);
+cv::Size my::FaceDetection::getOriginalImageSize() const {
+    return getImageSize(m_originImage, ModelLoader::getPixelFormat());
 }
 
 
-std::vector<float> my::FaceDetection::getFaceClassificator() const {
-    return ModelLoader::loadOutput(1);
+my::TensorView<float> my::FaceDetection::getFaceRegressor() const {
+    return ModelLoader::getOutputView(0);
+}
+
+
+my::TensorView<float> my::FaceDetection::getFaceClassificator() const {
+    return ModelLoader::getOutputView(1);
 }
 
 
@@ -51,8 +103,63 @@ cv::Rect my::FaceDetection::getFaceRoi() const {
 }
 
 
+std::vector<cv::Rect> my::FaceDetection::getFaceRois() const {
+    return m_rois;
+}
+
+
+const std::vector<my::Detection>& my::FaceDetection::getDetections() const {
+    return m_detections;
+}
+
+
+bool my::FaceDetection::getFaceKeypoint(FaceKeypoint keypoint, cv::Point2f& point) const {
+    if (m_detections.empty()) 
+        return false;
+
+    point = toImagePoint(m_detections[0].getKeypoint(keypoint), getOriginalImageSize());
+    return true;
+}
+
+
+cv::RotatedRect my::FaceDetection::getRotatedFaceRoi() const {
+    if (m_detections.empty())
+        return cv::RotatedRect();
+
+    return calculateRotatedRoiFromDetection(m_detections[0], getOriginalImageSize());
+}
+
+
+void my::FaceDetection::setMaxFaces(int maxFaces) {
+    m_maxFaces = std::max(maxFaces, 1);
+}
+
+
+int my::FaceDetection::getMaxFaces() const {
+    return m_maxFaces;
+}
+
+
 cv::Mat my::FaceDetection::cropFrame(const cv::Rect& roi) const {
-    cv::Mat frame = getOriginalImage();
+    auto format = ModelLoader::getPixelFormat();
+    if (format == PixelFormat::BGR)
+        return cropFrame(getOriginalImage(), roi);
+
+    cv::Mat face;
+    cropToBGR(getOriginalImage(), format, roi, face);
+    return face;
+}
+
+
+cv::Mat my::FaceDetection::cropFrame(const cv::Mat& frame, const cv::Rect& roi) {
+    cv::Mat face;
+    cropFrame(frame, roi, face);
+    return face;
+}
+
+
+void my::FaceDetection::cropFrame(const cv::Mat& frame, const cv::Rect& roi, cv::Mat& face) {
+    METRICS_SCOPE(getCropStage());
     cv::Size originalSize(roi.size());
 
     cv::Point offsetStart(0, 0);
@@ -79,16 +186,15 @@ cv::Mat my::FaceDetection::cropFrame(const cv::Rect& roi) const {
         pt2.y = frame.rows - 1;
     }
 
-    cv::Mat face(originalSize, CV_8UC3, cv::Scalar(0));
+    face.create(originalSize, CV_8UC3);
+    face.setTo(cv::Scalar(0));
     frame(cv::Rect(pt1, pt2)).copyTo(face(cv::Rect(offsetStart, offsetEnd)));
-    return face;
 }
 
-//-------------------Private methods start here-------------------
 
-cv::Rect my::FaceDetection::calculateRoiFromDetection(const Detection& detection) const {
-    int origWidth = m_originImage.size().width;
-    int origHeight = m_originImage.size().height;
+cv::Rect my::FaceDetection::calculateRoiFromDetection(const Detection& detection, const cv::Size& imageSize) {
+    int origWidth = imageSize.width;
+    int origHeight = imageSize.height;
     
     auto center = (detection.roi.tl() + detection.roi.br()) * 0.5f;
     center.x *= origWidth;
@@ -98,4 +204,73 @@ cv::Rect my::FaceDetection::calculateRoiFromDetection(const Detection& detection
     auto h = detection.roi.height * origHeight * 2.f;
 
     return cv::Rect((int)center.x - w/2, (int)center.y - h/2, (int)w, (int)h);
-}
\ No newline at end of file
+}
+
+cv::RotatedRect my::FaceDetection::calculateRotatedRoiFromDetection
+(const Detection& detection, const cv::Size& imageSize) {
+    auto center = toImagePoint((detection.roi.tl() + detection.roi.br()) * 0.5f, imageSize);
+    cv::Size2f size(detection.roi.width * imageSize.width * 1.5f, detection.roi.height * imageSize.height * 2.f);
+
+    auto eyes = toImagePoint(detection.getKeypoint(FaceKeypoint::LeftEye), imageSize) - 
+                toImagePoint(detection.getKeypoint(FaceKeypoint::RightEye), imageSize);
+    float angle = std::atan2(eyes.y, eyes.x) * 180.f / (float)CV_PI;
+
+    return cv::RotatedRect(center, size, angle);
+}
+
+
+cv::Rect my::FaceDetection::calculateEyeRoiFromDetection
+(const Detection& detection, const cv::Size& imageSize, bool isLeftEye) {
+    auto left = toImagePoint(detection.getKeypoint(FaceKeypoint::LeftEye), imageSize);
+    auto right = toImagePoint(detection.getKeypoint(FaceKeypoint::RightEye), imageSize);
+    auto center = isLeftEye ? left : right;
+
+    auto eyes = left - right;
+    int w = (int)(std::hypot(eyes.x, eyes.y) * EYE_ROI_SCALE);
+    return cv::Rect((int)center.x - w/2, (int)center.y - w/2, w, w);
+}
+
+//-------------------Protected methods start here-------------------
+
+void my::FaceDetection::setFaceRoi(const cv::Rect& roi) {
+    m_roi = roi;
+    m_rois.clear();
+    m_detections.clear();
+    if (!roi.empty()) m_rois.push_back(roi);
+}
+
+
+//-------------------Private methods start here-------------------
+
+template <class Scores>
+void my::FaceDetection::detectFaces(const Scores& scores) {
+    m_rois.clear();
+    m_detections.clear();
+
+    if (m_detectorRange == DetectorRange::Full)
+        decodeDetections(m_fullRangePostProcessor, scores);
+    else
+        decodeDetections(m_shortRangePostProcessor, scores);
+
+    /*
+    The detections are still in local shape [0..1]
+    */
+    for (auto& detection: m_detections) {
+        m_rois.push_back(calculateRoiFromDetection(detection, getOriginalImageSize()));
+    }
+}
+
+
+template <class PostProcessor, class Scores>
+void my::FaceDetection::decodeDetections(const PostProcessor& postProcessor, const Scores& scores) {
+    auto regressor = getFaceRegressor();
+
+    if (m_maxFaces > 1) {
+        postProcessor.getDetections(regressor, scores, m_maxFaces, m_detections);
+    }
+    else {
+        auto detection = postProcessor.getHighestScoreDetection(regressor, scores);
+        if (detection.classId != -1) 
+            m_detections.push_back(detection);
+    }
+}
@@ -6,6 +6,19 @@
 
 namespace my {
 
+    /*
+    Where the iris stage takes its eye Rois from:
+        FaceMesh: eye corners of the face mesh of the same frame (the iris models wait for the mesh)
+        Detection: eye keypoints of the detector, the iris models run at the same time as the mesh
+        PreviousFrame: face mesh of the previous frame, the iris models run at the same time as the mesh
+    The two parallel sources fall back on each other, then on FaceMesh, when they have nothing for the frame.
+    */
+    enum class EyeRoiSource {
+        FaceMesh,
+        Detection,
+        PreviousFrame
+    };
+
     /*
     A model wrapper to use Mediapipe Face Detector.
     This class is non-copyable.
@@ -13,25 +26,39 @@ namespace my {
     class FaceDetection : public my::ModelLoader {
         public:
             /*
-            Users MUST provide the FOLDER contain face_detection_short.tflite, NOT THE FILE itself.
+            Users MUST provide the FOLDER contain face_detection_short.tflite 
+            (face_detection_full_range.tflite for DetectorRange::Full, not shipped: see README), NOT THE FILE itself.
+            options: interpreter settings of the detector
+            range: which detector to load, its decoder is chosen here, once
             */
-            FaceDetection(std::string modelPath);
+            FaceDetection(std::string modelPath, const InterpreterOptions& options = InterpreterOptions(),
+                          DetectorRange range = DetectorRange::Short);
             virtual ~FaceDetection() = default;
 
+            /*
+            Get the detector loaded at construction
+            */
+            DetectorRange getDetectorRange() const;
+
             /*
             Get access to original input image
             */
             cv::Mat getOriginalImage() const;
 
             /*
-            Get the regressor result (first output tensor).
+            Get width and height of the original input image in pixels (see PixelFormat)
+            */
+            cv::Size getOriginalImageSize() const;
+
+            /*
+            Get the regressor result (first output tensor), without copy.
             */
-            std::vector<float> getFaceRegressor() const;
+            TensorView<float> getFaceRegressor() const;
 
             /*
-            Get the classificator result (second output tensor).
+            Get the classificator result (second output tensor), without copy.
             */         
-            std::vector<float> getFaceClassificator() const;
+            TensorView<float> getFaceClassificator() const;
 
             /*
             Get the position of the HIGHEST CONFIDENT face
@@ -39,9 +66,41 @@ namespace my {
             */
             virtual cv::Rect getFaceRoi() const;
 
+            /*
+            Get the positions of all detected faces, sorted by confidence
+            (at most getMaxFaces() faces, the first one is getFaceRoi())
+            */
+            std::vector<cv::Rect> getFaceRois() const;
+
+            /*
+            Get the detections of the last detector run, sorted by confidence
+            (box and keypoints in local shape [0..1]). 
+            Empty when the face Roi was not given by the detector (e.g. tracked).
+            */
+            const std::vector<Detection>& getDetections() const;
+
+            /*
+            Get a keypoint of the HIGHEST CONFIDENT face relative to the input image
+            Return false if there is no detection
+            */
+            bool getFaceKeypoint(FaceKeypoint keypoint, cv::Point2f& point) const;
+
+            /*
+            Get the face Roi of the HIGHEST CONFIDENT detection, turned so that the eyes are horizontal.
+            Empty (zero size) if there is no detection.
+            */
+            cv::RotatedRect getRotatedFaceRoi() const;
+
+            /*
+            Set the maximum number of faces kept by the detector (default 1)
+            */
+            void setMaxFaces(int maxFaces);
+            int getMaxFaces() const;
+
             /*
             Override function from ModelLoader.
             (Note: index does not matter, the model always load to InputTensor(0))
+            The image is only preprocessed when the detector actually runs.
             */
             virtual void loadImageToInput(const cv::Mat& inputImage, int index = 0);       
 
@@ -52,10 +111,45 @@ namespace my {
             virtual void runInference();
 
             /*
-            Crop input frame at roi (padding if need)
+            Crop input frame at roi (padding if need), as BGR whatever the pixel format
             */
             cv::Mat cropFrame(const cv::Rect& roi) const;
 
+            /*
+            Crop any BGR frame at roi (padding if need)
+            */
+            static cv::Mat cropFrame(const cv::Mat& frame, const cv::Rect& roi);
+
+            /*
+            Same as above into face, whose buffer is reused when it already has the Roi size
+            */
+            static void cropFrame(const cv::Mat& frame, const cv::Rect& roi, cv::Mat& face);
+
+            /*       
+            Convert Detection box (local shape [0..1]) back to a face Roi in an image of imageSize
+            */
+            static cv::Rect calculateRoiFromDetection(const Detection& detection, const cv::Size& imageSize);
+
+            /*
+            Same Roi as calculateRoiFromDetection, rotated by the angle of the line between the eyes
+            (cv::RotatedRect angle in degrees, clockwise in image coordinates)
+            */
+            static cv::RotatedRect calculateRotatedRoiFromDetection(const Detection& detection, const cv::Size& imageSize);
+
+            /*
+            Square eye Roi centered on an eye keypoint, sized from the distance between the eyes
+            (close to the Roi computed from the face mesh eye corners)
+            */
+            static cv::Rect calculateEyeRoiFromDetection(const Detection& detection, const cv::Size& imageSize, bool isLeftEye);
+
+
+        protected:
+            /*
+            Replace the face Roi without running the detector
+            (e.g. when the Roi is tracked from the previous landmarks)
+            */
+            void setFaceRoi(const cv::Rect& roi);
+
 
         private:
             /*
@@ -64,23 +158,35 @@ namespace my {
             */
             using ModelLoader::loadBytesToInput;
 
-            /*       
-            Convert Detection box back to original size
+            /*
+            Fill m_rois from the detector outputs, scores are a float TensorView or a QuantizedView
             */
-            cv::Rect calculateRoiFromDetection(const Detection& detection) const;
+            template <class Scores>
+            void detectFaces(const Scores& scores);
 
+            /*
+            Decode m_detections with the post-processor of the loaded detector
+            */
+            template <class PostProcessor, class Scores>
+            void decodeDetections(const PostProcessor& postProcessor, const Scores& scores);
 
         private:
             /*
-            Help getting Region of Interest from model outputs
+            Help getting Region of Interest from model outputs, 
+            one decoder per detector (only the one of m_detectorRange is used)
             */
-            DetectionPostProcess m_postProcessor;
+            DetectorRange m_detectorRange;
+            DetectionPostProcess<ShortRangeAnchorConfig> m_shortRangePostProcessor;
+            DetectionPostProcess<FullRangeAnchorConfig> m_fullRangePostProcessor;
 
             /*
             Save some informations
             */
             cv::Mat m_originImage;
             cv::Rect m_roi;
+            std::vector<cv::Rect> m_rois;
+            std::vector<Detection> m_detections;
+            int m_maxFaces;
     };
 }
 #endif // FACEDETECTION_H
\ No newline at end of file
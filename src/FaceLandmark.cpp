@@ -1,8 +1,15 @@
 #include "FaceLandmark.hpp"
+#include "LandmarkTransform.hpp"
+#include "Metrics.hpp"
 #include <iostream>
+#include <climits>
+#include <cmath>
 
 
-#define FACE_LANDMARKS 468
+#define FACE_LANDMARKS      468
+#define TRACKING_ROI_SCALE  1.5f
+#define LEFT_EYE_CORNER     263
+#define RIGHT_EYE_CORNER    33
 /*
 Helper function
 */
@@ -16,51 +23,220 @@ bool __isIndexValid(int idx) {
 }
 
 
-my::FaceLandmark::FaceLandmark(std::string modelPath):
-    FaceDetection(modelPath),
-    m_landmarkModel(modelPath + std::string("/face_landmark.tflite"))
+my::FaceLandmark::FaceLandmark(std::string modelPath, const PipelineOptions& options):
+    FaceDetection(modelPath, options.detection, options.detectorRange),
+    m_landmarkModel(modelPath + std::string("/face_landmark.tflite"), options.landmark),
+    m_trackingEnabled(false),
+    m_isTracking(false),
+    m_redetectInterval(0),
+    m_framesSinceDetection(0),
+    m_minPresence(0.f),
+    m_facePresence(0.f),
+    m_rotateRoi(true),
+    m_roiAngle(0.f)
     {}
 
 
 void my::FaceLandmark::runInference() {
+    m_stageTimes = StageTimes();
+    bool needDetection = !m_isTracking || 
+        (m_redetectInterval > 0 && m_framesSinceDetection >= m_redetectInterval);
+
+    if (!needDetection) {
+        /*
+        Build the Roi from the previous mesh, fall back to the detector if the face is lost
+        */
+        Stopwatch landmarkTime;
+        m_roiAngle = m_rotateRoi ? calculateAngleFromLandmarks() : 0.f;
+        FaceDetection::setFaceRoi(calculateRoiFromLandmarks());
+        runLandmarkInference();
+        m_stageTimes.landmarkMs += landmarkTime.getElapsedMs();
+        m_framesSinceDetection++;
+
+        if (m_facePresence >= m_minPresence) return;
+    }
+
+    Stopwatch detectionTime;
     FaceDetection::runInference();
-    auto roi = FaceDetection::getFaceRoi();
-    if (roi.empty()) return;
+    m_stageTimes.detectionMs = detectionTime.getElapsedMs();
+    m_framesSinceDetection = 0;
+    m_roiAngle = m_rotateRoi ? FaceDetection::getRotatedFaceRoi().angle : 0.f;
 
-    auto face = FaceDetection::cropFrame(roi);
-    m_landmarkModel.loadImageToInput(face);
-    m_landmarkModel.runInference();
+    Stopwatch landmarkTime;
+    runLandmarkInference();
+    m_stageTimes.landmarkMs += landmarkTime.getElapsedMs();
+
+    m_isTracking = m_trackingEnabled && m_facePresence >= m_minPresence;
 }
 
 
 cv::Point my::FaceLandmark::getFaceLandmarkAt(int index) const {
     if (__isIndexValid(index)) {
-        auto roi = FaceDetection::getFaceRoi();
+        auto output = m_landmarkModel.getOutputView();
+        float point[3];
+        transformLandmarks(output.data + index * 3, 1, m_landmarkModel.getInputImageSize(), m_meshRoi, point);
 
-        float _x = m_landmarkModel.getOutputData()[index * 3];
-        float _y = m_landmarkModel.getOutputData()[index * 3 + 1];
-
-        int x = (int)(_x / m_landmarkModel.getInputShape()[2] * roi.width) + roi.x;
-        int y = (int)(_y / m_landmarkModel.getInputShape()[1] * roi.height) + roi.y;
-
-        return cv::Point(x,y);
+        return cv::Point((int)point[0], (int)point[1]);
     }
     return cv::Point();
 }
 
 
 std::vector<cv::Point> my::FaceLandmark::getAllFaceLandmarks() const {
-    if (FaceDetection::getFaceRoi().empty())
+    auto roi = FaceDetection::getFaceRoi();
+    if (roi.empty())
         return std::vector<cv::Point>();
 
+    /*
+    Same conversion as getFaceLandmarkAt, for all landmarks in one pass
+    */
+    float points[FACE_LANDMARKS * 3];
+    getAllFaceLandmarks(points);
+
     std::vector<cv::Point> landmarks(FACE_LANDMARKS);
     for (int i = 0; i < FACE_LANDMARKS; ++i) {
-        landmarks[i] = getFaceLandmarkAt(i);
+        landmarks[i].x = (int)points[i * 3];
+        landmarks[i].y = (int)points[i * 3 + 1];
     }
     return landmarks;
 }
 
 
+int my::FaceLandmark::getAllFaceLandmarks(float* out) const {
+    auto roi = FaceDetection::getFaceRoi();
+    if (roi.empty())
+        return 0;
+
+    auto output = m_landmarkModel.getOutputView();
+    transformLandmarks(output.data, FACE_LANDMARKS, m_landmarkModel.getInputImageSize(), m_meshRoi, out);
+    return FACE_LANDMARKS;
+}
+
+
 std::vector<float> my::FaceLandmark::loadOutput(int index) const {
     return m_landmarkModel.loadOutput();
+}
+
+
+my::TensorView<float> my::FaceLandmark::getOutputView(int index) const {
+    return m_landmarkModel.getOutputView(index);
+}
+
+
+void my::FaceLandmark::setTrackingMode(bool enabled, int redetectInterval, float minPresence) {
+    m_trackingEnabled = enabled;
+    m_redetectInterval = redetectInterval;
+    m_minPresence = minPresence;
+    m_isTracking = false;
+}
+
+
+void my::FaceLandmark::setRoiRotation(bool enabled) {
+    m_rotateRoi = enabled;
+}
+
+
+cv::RotatedRect my::FaceLandmark::getMeshRoi() const {
+    return m_meshRoi;
+}
+
+
+bool my::FaceLandmark::isTracking() const {
+    return m_isTracking;
+}
+
+
+float my::FaceLandmark::getFacePresence() const {
+    return m_facePresence;
+}
+
+
+my::StageTimes my::FaceLandmark::getLastStageTimes() const {
+    return m_stageTimes;
+}
+
+
+void my::FaceLandmark::setNumThreads(int numThreads) {
+    ModelLoader::setNumThreads(numThreads);
+    m_landmarkModel.setNumThreads(numThreads);
+}
+
+
+void my::FaceLandmark::setPixelFormat(PixelFormat format) {
+    ModelLoader::setPixelFormat(format);
+    m_landmarkModel.setPixelFormat(format);
+}
+
+//-------------------Protected methods start here-------------------
+
+void my::FaceLandmark::runLandmarkInference() {
+    auto roi = FaceDetection::getFaceRoi();
+    if (roi.empty()) {
+        m_meshRoi = cv::RotatedRect();
+        m_facePresence = 0.f;
+        return;
+    }
+
+    m_meshRoi = ModelLoader::toRotatedRect(roi);
+    m_meshRoi.angle = m_roiAngle;
+    m_landmarkModel.loadRoiToInput(FaceDetection::getOriginalImage(), m_meshRoi);
+    m_landmarkModel.runInference();
+
+    /*
+    The face flag is a logit, older models without it are always considered present
+    */
+    if (m_landmarkModel.getNumberOfOutputs() > 1) {
+        float logit = m_landmarkModel.getOutputView(1)[0];
+        m_facePresence = 1.f / (1.f + std::exp(-logit));
+    }
+    else {
+        m_facePresence = 1.f;
+    }
+}
+
+
+void my::FaceLandmark::setIrisTime(float ms) {
+    m_stageTimes.irisMs = ms;
+}
+
+//-------------------Private methods start here-------------------
+
+cv::Rect my::FaceLandmark::calculateRoiFromLandmarks() const {
+    auto roi = FaceDetection::getFaceRoi();
+    if (roi.empty())
+        return cv::Rect();
+
+    /*
+    Bounding box of getAllFaceLandmarks(), without building the vector
+    */
+    float points[FACE_LANDMARKS * 3];
+    getAllFaceLandmarks(points);
+    cv::Point minPoint(INT_MAX, INT_MAX), maxPoint(INT_MIN, INT_MIN);
+
+    for (int i = 0; i < FACE_LANDMARKS; ++i) {
+        int x = (int)points[i * 3];
+        int y = (int)points[i * 3 + 1];
+        minPoint.x = std::min(minPoint.x, x); maxPoint.x = std::max(maxPoint.x, x);
+        minPoint.y = std::min(minPoint.y, y); maxPoint.y = std::max(maxPoint.y, y);
+    }
+
+    cv::Rect box(minPoint, maxPoint + cv::Point(1, 1));
+    auto center = (box.tl() + box.br()) * 0.5;
+
+    int w = (int)(box.width * TRACKING_ROI_SCALE);
+    int h = (int)(box.height * TRACKING_ROI_SCALE);
+    w = h = std::max(w, h);
+
+    return cv::Rect(center.x - w/2, center.y - h/2, w, h);
+}
+
+
+float my::FaceLandmark::calculateAngleFromLandmarks() const {
+    auto output = m_landmarkModel.getOutputView();
+    auto inputSize = m_landmarkModel.getInputImageSize();
+
+    float left[3], right[3];
+    transformLandmarks(output.data + LEFT_EYE_CORNER * 3, 1, inputSize, m_meshRoi, left);
+    transformLandmarks(output.data + RIGHT_EYE_CORNER * 3, 1, inputSize, m_meshRoi, right);
+    return std::atan2(left[1] - right[1], left[0] - right[0]) * 180.f / (float)CV_PI;
 }
\ No newline at end of file
@@ -5,6 +5,17 @@
 
 namespace my {
 
+    /*
+    Wall time (milliseconds) of each stage in the last runInference(), 0 for a stage that did not run.
+    With eye Rois known before the mesh (see IrisLandmark::setEyeRoiSource), the iris models run 
+    at the same time as the face mesh and are counted in landmarkMs.
+    */
+    struct StageTimes {
+        float detectionMs = 0.f;
+        float landmarkMs = 0.f;
+        float irisMs = 0.f;
+    };
+
     /*
     A model wrapper to use Mediapipe Face Detector.
     It also includes the detection phase.  
@@ -15,8 +26,9 @@ namespace my {
             /*
             Users MUST provide the FOLDER contain BOTH the face_detection_short.tflite 
             and face_landmark.tflite, 
+            options: interpreter settings of each stage (options.iris is not used)
             */
-            FaceLandmark(std::string modelPath);
+            FaceLandmark(std::string modelPath, const PipelineOptions& options = PipelineOptions());
             virtual ~FaceLandmark() = default; 
 
             /*
@@ -36,6 +48,13 @@ namespace my {
             */
             virtual std::vector<cv::Point> getAllFaceLandmarks() const;
 
+            /*
+            Write all landmarks to out in one pass: x, y (sub-pixel, relative to the input image at InputTensor(0))
+            and z (same scale as x) of each landmark. out must hold 468 * 3 floats.
+            Return the number of landmarks written (0 without face).
+            */
+            int getAllFaceLandmarks(float* out) const;
+
             /*
             Get all landmarks from output, which is a vector of length 468 * 3 * 4 (although the first 468 * 3 are enough).
             (Note: index does not matter, it always load from OutputTensor(0))
@@ -44,10 +63,107 @@ namespace my {
             */
             virtual std::vector<float> loadOutput(int index = 0) const;
 
+            /*
+            Same as loadOutput() but without copy.
+            index = 0: landmarks, index = 1: face flag
+            */
+            virtual TensorView<float> getOutputView(int index = 0) const;
+
+            /*
+            Enable/disable tracking mode.
+            In tracking mode, the face Roi is built from the landmarks of the previous frame
+            and the face detector only runs when the face presence drops below minPresence
+            or every redetectInterval frames (redetectInterval <= 0: only on lost track).
+            */
+            void setTrackingMode(bool enabled, int redetectInterval = 30, float minPresence = 0.5f);
+
+            /*
+            Check if the current face Roi was tracked from the previous frame.
+            */
+            bool isTracking() const;
+
+            /*
+            Enable/disable the rotated face Roi (enabled by default).
+            The face mesh then runs on a crop turned so that the eyes are horizontal (angle from the detection 
+            keypoints, or from the eye corners of the previous mesh when tracking), as the model expects, 
+            and its landmarks are turned back into the frame. getFaceRoi() stays axis-aligned.
+            */
+            void setRoiRotation(bool enabled);
+
+            /*
+            Get the Roi the face mesh was cropped from in the last inference (angle 0 without rotation)
+            */
+            cv::RotatedRect getMeshRoi() const;
+
+            /*
+            Get the face presence score [0..1] of the last inference
+            (second output of Mediapipe Face Landmark model).
+            */
+            float getFacePresence() const;
+
+            /*
+            Get the time taken by each stage in the last runInference()
+            */
+            StageTimes getLastStageTimes() const;
+
+            /*
+            Override function from ModelLoader: change the threads of the detector and the face mesh
+            */
+            virtual void setNumThreads(int numThreads);
+
+            /*
+            Override function from ModelLoader: the detector and the face mesh read frames of format
+            */
+            virtual void setPixelFormat(PixelFormat format);
+
+
+        protected:
+            /*
+            Run face landmark model on the current face Roi
+            (called once or twice per runInference(), after the face Roi of the frame is known)
+            */
+            virtual void runLandmarkInference();
+
+            /*
+            Record the time of the iris stage of the last runInference()
+            */
+            void setIrisTime(float ms);
+
+
+        private:
+            /*
+            Calculate the next face Roi from the current landmarks
+            */
+            cv::Rect calculateRoiFromLandmarks() const;
+
+            /*
+            Angle (degrees, as cv::RotatedRect) of the line between the eye corners of the current landmarks
+            */
+            float calculateAngleFromLandmarks() const;
+
 
         private:
             my::ModelLoader m_landmarkModel;
 
+            /*
+            Tracking state
+            */
+            bool m_trackingEnabled;
+            bool m_isTracking;
+            int m_redetectInterval;
+            int m_framesSinceDetection;
+            float m_minPresence;
+            float m_facePresence;
+
+            /*
+            Rotation of the face Roi: m_roiAngle is the angle for the next mesh, m_meshRoi the last crop
+            */
+            bool m_rotateRoi;
+            float m_roiAngle;
+            cv::RotatedRect m_meshRoi;
+
+            StageTimes m_stageTimes;
+
     };
 }
 
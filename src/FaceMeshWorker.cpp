@@ -0,0 +1,142 @@
+#include "FaceMeshWorker.hpp"
+#include "FaceDetection.hpp"
+#include "LandmarkTransform.hpp"
+#include <cmath>
+
+#define FACE_LANDMARKS  468
+#define EYE_LANDMARKS   71
+#define IRIS_LANDMARKS  5
+
+/*
+Helper function
+*/
+cv::Rect calculateEyeRoiFromCorners(cv::Point leftMost, cv::Point rightMost) {
+    int cx = (leftMost.x + rightMost.x) / 2;
+    int cy = (leftMost.y + rightMost.y) / 2; 
+
+    int w = std::abs(leftMost.x - rightMost.x);
+    int h = std::abs(leftMost.y - rightMost.y);
+    w = h = std::max(w, h);
+    
+    return cv::Rect(cx - w/2, cy - h/2, w, h);
+}
+
+
+my::FaceMeshWorker::FaceMeshWorker(std::string modelPath, const PipelineOptions& options):
+    m_landmarkModel(modelPath + std::string("/face_landmark.tflite"), options.landmark),
+    m_leftIrisLandmarker(modelPath + std::string("/iris_landmark.tflite"), options.iris),
+    m_rightIrisLandmarker(modelPath + std::string("/iris_landmark.tflite"), options.iris)
+    {}
+
+
+void my::FaceMeshWorker::runFaceLandmark(const cv::Mat& frame, const cv::Rect& roi, FaceResult& result) {
+    runFaceLandmark(m_landmarkModel, frame, roi, result);
+}
+
+
+void my::FaceMeshWorker::runIrisLandmark(const cv::Mat& frame, FaceResult& result) {
+    if (result.faceLandmarks.size() != FACE_LANDMARKS) return;
+
+    runEyeLandmark(m_leftIrisLandmarker, frame, true, result);
+    runEyeLandmark(m_rightIrisLandmarker, frame, false, result);
+}
+
+
+void my::FaceMeshWorker::process(const cv::Mat& frame, const cv::Rect& roi, FaceResult& result) {
+    runFaceLandmark(frame, roi, result);
+    runIrisLandmark(frame, result);
+}
+
+
+void my::FaceMeshWorker::setPixelFormat(PixelFormat format) {
+    m_landmarkModel.setPixelFormat(format);
+    m_leftIrisLandmarker.setPixelFormat(format);
+    m_rightIrisLandmarker.setPixelFormat(format);
+}
+
+
+void my::FaceMeshWorker::runFaceLandmark
+(ModelLoader& model, const cv::Mat& frame, const cv::Rect& roi, FaceResult& result) {
+    result.roi = roi;
+    result.faceLandmarks.clear();
+    result.presence = 0.f;
+    if (roi.empty()) return;
+
+    model.loadRoiToInput(frame, roi);
+    model.runInference();
+
+    getLandmarks(model, 0, FACE_LANDMARKS, roi, result.faceLandmarks);
+    result.presence = 1.f;
+    if (model.getNumberOfOutputs() > 1) {
+        float logit = model.getOutputView(1)[0];
+        result.presence = 1.f / (1.f + std::exp(-logit));
+    }
+}
+
+
+void my::FaceMeshWorker::runEyeLandmark
+(ModelLoader& model, const cv::Mat& frame, bool isLeftEye, FaceResult& result) {
+    if (result.faceLandmarks.size() != FACE_LANDMARKS) return;
+
+    runEyeLandmark(model, frame, calculateEyeRoi(result, isLeftEye), isLeftEye, result);
+}
+
+
+void my::FaceMeshWorker::runEyeLandmark
+(ModelLoader& model, const cv::Mat& frame, const cv::Rect& eyeRoi, bool isLeftEye, FaceResult& result) {
+    auto roi = isLeftEye ? &result.leftEyeRoi : &result.rightEyeRoi;
+    auto eye = isLeftEye ? &result.leftEyeLandmarks : &result.rightEyeLandmarks;
+    auto iris = isLeftEye ? &result.leftIrisLandmarks : &result.rightIrisLandmarks;
+
+    *roi = eyeRoi;
+    if (roi->empty()) {
+        eye->clear(); 
+        iris->clear();
+        return;
+    }
+
+    model.loadRoiToInput(frame, *roi);
+    model.runInference();
+
+    getLandmarks(model, 0, EYE_LANDMARKS, *roi, *eye);
+    getLandmarks(model, 1, IRIS_LANDMARKS, *roi, *iris);
+}
+
+std::vector<cv::Point> my::FaceMeshWorker::getLandmarks
+(const ModelLoader& model, int outputIndex, int count, const cv::Rect& roi) {
+    std::vector<cv::Point> landmarks;
+    getLandmarks(model, outputIndex, count, roi, landmarks);
+    return landmarks;
+}
+
+
+void my::FaceMeshWorker::getLandmarks
+(const ModelLoader& model, int outputIndex, int count, const cv::Rect& roi, std::vector<cv::Point>& landmarks) {
+    auto data = model.getOutputView(outputIndex);
+    auto inputSize = model.getInputImageSize();
+    float scaleX = (float)roi.width / inputSize.width;
+    float scaleY = (float)roi.height / inputSize.height;
+
+    landmarks.resize(count);
+    for (int i = 0; i < count; ++i) {
+        landmarks[i].x = (int)(data[i * 3] * scaleX) + roi.x;
+        landmarks[i].y = (int)(data[i * 3 + 1] * scaleY) + roi.y;
+    }
+}
+
+
+void my::FaceMeshWorker::getLandmarks
+(const ModelLoader& model, int outputIndex, int count, const cv::Rect& roi, float* out) {
+    auto data = model.getOutputView(outputIndex);
+    transformLandmarks(data.data, count, model.getInputImageSize(), roi, out);
+}
+
+
+cv::Rect my::FaceMeshWorker::calculateEyeRoi(const FaceResult& result, bool isLeftEye) {
+    if (result.faceLandmarks.size() != FACE_LANDMARKS) 
+        return cv::Rect();
+
+    int idx1 = isLeftEye ? 446 : 244;
+    int idx2 = isLeftEye ? 464 : 226;
+    return calculateEyeRoiFromCorners(result.faceLandmarks[idx1], result.faceLandmarks[idx2]);
+}
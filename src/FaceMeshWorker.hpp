@@ -0,0 +1,116 @@
+#ifndef FACEMESHWORKER_H
+#define FACEMESHWORKER_H
+
+#include "ModelLoader.hpp"
+
+namespace my {
+
+    /*
+    All landmarks of a single face.
+    The positions are relative to the original frame.
+    */
+    struct FaceResult {
+        cv::Rect roi;
+        float presence;
+        std::vector<cv::Point> faceLandmarks;
+
+        cv::Rect leftEyeRoi;
+        cv::Rect rightEyeRoi;
+        std::vector<cv::Point> leftEyeLandmarks;
+        std::vector<cv::Point> rightEyeLandmarks;
+        std::vector<cv::Point> leftIrisLandmarks;
+        std::vector<cv::Point> rightIrisLandmarks;
+
+        FaceResult() : presence(0.f) {}
+        ~FaceResult() = default;
+    };
+
+    /*
+    Run the face landmark and iris landmark models on ONE face Roi.
+    Each worker owns its interpreters, so different workers can run in parallel.
+    The two stages use different interpreters, so runFaceLandmark() and runIrisLandmark()
+    of the same worker may run at the same time on different frames.
+    This class is non-copyable.
+    */
+    class FaceMeshWorker {
+        public:
+            /*
+            Users MUST provide the FOLDER contain BOTH face_landmark.tflite
+            and iris_landmark.tflite
+            options: interpreter settings of each stage (options.detection is not used)
+            */
+            FaceMeshWorker(std::string modelPath, const PipelineOptions& options = PipelineOptions());
+            FaceMeshWorker(const FaceMeshWorker& other) = delete;
+            FaceMeshWorker& operator=(const FaceMeshWorker& other) = delete;
+            ~FaceMeshWorker() = default;
+
+            /*
+            Run face landmark on frame at roi, the result is written to result.faceLandmarks
+            */
+            void runFaceLandmark(const cv::Mat& frame, const cv::Rect& roi, FaceResult& result);
+
+            /*
+            Run iris landmark on both eyes, result.faceLandmarks must be filled first
+            */
+            void runIrisLandmark(const cv::Mat& frame, FaceResult& result);
+
+            /*
+            Run both stages
+            */
+            void process(const cv::Mat& frame, const cv::Rect& roi, FaceResult& result);
+
+            /*
+            Set the layout of the frames given to the worker models (default PixelFormat::BGR).
+            Models given to the static functions keep their own format.
+            */
+            void setPixelFormat(PixelFormat format);
+
+            /*
+            Same stages on interpreters owned by the caller (e.g. taken from a pool).
+            model must be loaded from face_landmark.tflite / iris_landmark.tflite.
+            runEyeLandmark() only writes the fields of one eye, so both eyes may run in parallel.
+            */
+            static void runFaceLandmark
+            (ModelLoader& model, const cv::Mat& frame, const cv::Rect& roi, FaceResult& result);
+            static void runEyeLandmark
+            (ModelLoader& model, const cv::Mat& frame, bool isLeftEye, FaceResult& result);
+
+            /*
+            Same as above at a given eye Roi (e.g. from the detection keypoints):
+            result.faceLandmarks is not read, so the mesh of the same result may run at the same time.
+            */
+            static void runEyeLandmark
+            (ModelLoader& model, const cv::Mat& frame, const cv::Rect& eyeRoi, bool isLeftEye, FaceResult& result);
+
+            /*
+            Convert raw model output to positions relative to the original frame
+            */
+            static std::vector<cv::Point> getLandmarks
+            (const ModelLoader& model, int outputIndex, int count, const cv::Rect& roi);
+
+            /*
+            Same as above into landmarks, its capacity is reused (no allocation once warm)
+            */
+            static void getLandmarks
+            (const ModelLoader& model, int outputIndex, int count, const cv::Rect& roi, std::vector<cv::Point>& landmarks);
+
+            /*
+            Same conversion to x, y (sub-pixel) and z floats written to out (count * 3 floats)
+            */
+            static void getLandmarks
+            (const ModelLoader& model, int outputIndex, int count, const cv::Rect& roi, float* out);
+
+            /*
+            Calculate eye Roi from the eye corners in result.faceLandmarks
+            */
+            static cv::Rect calculateEyeRoi(const FaceResult& result, bool isLeftEye);
+
+
+        private:
+            ModelLoader m_landmarkModel;
+            ModelLoader m_leftIrisLandmarker;
+            ModelLoader m_rightIrisLandmarker;
+    };
+}
+
+#endif // FACEMESHWORKER_H
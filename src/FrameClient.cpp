@@ -0,0 +1,160 @@
+#include "FrameClient.hpp"
+
+
+my::FrameClient::FrameClient():
+    m_control(nullptr),
+    m_clientId(0),
+    m_session(0),
+    m_pendingFrame(nullptr),
+    m_pendingTicket(0),
+    m_hasResult(false),
+    m_resultTicket(0)
+{}
+
+
+my::FrameClient::~FrameClient() {
+    disconnect();
+}
+
+
+bool my::FrameClient::connect(const std::string& serverName) {
+    disconnect();
+
+    std::unique_ptr<SharedMemory> memory(new SharedMemory(serverName, 0, false));
+    if (!memory->isOpened() || memory->getSize() < sizeof(FrameServerControl))
+        return false;
+
+    auto control = reinterpret_cast<FrameServerControl*>(memory->getData());
+    if (control->magic != FRAME_SERVER_MAGIC || control->version != FRAME_SERVER_VERSION ||
+        memory->getSize() < control->totalBytes || control->isRunning.load(std::memory_order_acquire) == 0)
+        return false;
+
+    /*
+    Sessions are never 0, which marks a free entry
+    */
+    uint32_t session = control->nextSession.fetch_add(1) + 1;
+    if (session == 0) session = control->nextSession.fetch_add(1) + 1;
+
+    uint64_t owner = makeClientOwner(getCurrentProcessId(), session);
+    for (uint32_t i = 0; i < control->maxClients; ++i) {
+        uint64_t expected = 0;
+        if (!control->clientOwners[i].compare_exchange_strong(expected, owner))
+            continue;
+
+        std::unique_ptr<NamedSemaphore> requestSemaphore(new NamedSemaphore(getRequestSemaphoreName(serverName), false));
+        std::unique_ptr<NamedSemaphore> resultSemaphore(new NamedSemaphore(getResultSemaphoreName(serverName, i), false));
+        if (!requestSemaphore->isOpened() || !resultSemaphore->isOpened()) {
+            control->clientOwners[i].store(0);
+            return false;
+        }
+
+        m_requests.attach(memory->getData() + control->requestRingOffset);
+        m_results.attach(memory->getData() + control->resultRingOffset + i * control->resultRingBytes);
+        m_memory = std::move(memory);
+        m_requestSemaphore = std::move(requestSemaphore);
+        m_resultSemaphore = std::move(resultSemaphore);
+        m_control = control;
+        m_clientId = i;
+        m_session = session;
+        return true;
+    }
+    return false;
+}
+
+
+void my::FrameClient::disconnect() {
+    if (!isConnected()) return;
+
+    if (m_hasResult) releaseResult();
+    /*
+    A frame acquired but not submitted would block the request ring of every client
+    */
+    if (m_pendingFrame != nullptr) {
+        m_pendingFrame->width = 0;
+        submitFrame(0);
+    }
+    m_control->clientOwners[m_clientId].store(0);
+
+    m_requestSemaphore.reset();
+    m_resultSemaphore.reset();
+    m_memory.reset();
+    m_control = nullptr;
+    m_requests = SharedRing();
+    m_results = SharedRing();
+}
+
+
+bool my::FrameClient::isConnected() const {
+    return m_control != nullptr;
+}
+
+
+uint8_t* my::FrameClient::acquireFrame(FrameFormat format, uint32_t width, uint32_t height) {
+    if (!isConnected() || m_pendingFrame != nullptr) return nullptr;
+
+    size_t bytes = getFrameBytes(format, width, height);
+    if (bytes == 0 || bytes > getMaxFrameBytes()) return nullptr;
+
+    auto payload = static_cast<uint8_t*>(m_requests.tryAcquireWrite(m_pendingTicket));
+    if (payload == nullptr) return nullptr;
+
+    m_pendingFrame = reinterpret_cast<SharedFrameHeader*>(payload);
+    m_pendingFrame->clientId = m_clientId;
+    m_pendingFrame->session = m_session;
+    m_pendingFrame->format = format;
+    m_pendingFrame->width = width;
+    m_pendingFrame->height = height;
+    m_pendingFrame->stride = getFrameStride(format, width);
+    return payload + FRAME_DATA_OFFSET;
+}
+
+
+void my::FrameClient::submitFrame(uint64_t frameId, int64_t timestamp) {
+    if (m_pendingFrame == nullptr) return;
+
+    m_pendingFrame->frameId = frameId;
+    m_pendingFrame->timestamp = timestamp;
+    m_requests.publish(m_pendingTicket);
+    m_pendingFrame = nullptr;
+    m_requestSemaphore->post();
+}
+
+
+const my::SharedResult* my::FrameClient::acquireResult(int timeoutMs) {
+    if (!isConnected() || m_hasResult) return nullptr;
+
+    while (true) {
+        auto result = static_cast<const SharedResult*>(m_results.tryAcquireRead(m_resultTicket));
+        if (result != nullptr) {
+            /*
+            Results for a previous owner of this client entry are skipped
+            */
+            if (result->session == m_session) {
+                m_hasResult = true;
+                return result;
+            }
+            m_results.release(m_resultTicket);
+            continue;
+        }
+        if (timeoutMs <= 0 || !m_resultSemaphore->wait(timeoutMs))
+            return nullptr;
+    }
+}
+
+
+void my::FrameClient::releaseResult() {
+    if (!m_hasResult) return;
+
+    m_results.release(m_resultTicket);
+    m_hasResult = false;
+}
+
+
+size_t my::FrameClient::getMaxFrameBytes() const {
+    return isConnected() ? (size_t)m_control->maxFrameBytes : 0;
+}
+
+
+uint64_t my::FrameClient::getDroppedResults() const {
+    return isConnected() ? m_control->droppedResults[m_clientId].load() : 0;
+}
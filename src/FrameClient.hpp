@@ -0,0 +1,93 @@
+#ifndef FRAMECLIENT_H
+#define FRAMECLIENT_H
+
+#include <memory>
+#include <string>
+
+#include "FrameServerProtocol.hpp"
+#include "SharedMemory.hpp"
+#include "SharedRing.hpp"
+
+namespace my {
+
+    /*
+    Client of a FrameServer running on the same host.
+    Frames are written directly into the shared request ring (no copy on the server side),
+    results are read in place from the result ring of this client:
+        uint8_t* pixels = client.acquireFrame(FrameFormat::NV12, 1280, 720);
+        if (pixels) { fill pixels; client.submitFrame(frameId, timestamp); }
+        const SharedResult* result = client.acquireResult(100);
+        if (result) { use result; client.releaseResult(); }
+    Results may come back out of order when the server has several workers (use frameId).
+    When the result ring is full, the server drops the new results (see getDroppedResults()).
+    Fill acquired frames promptly: a slot acquired but not submitted holds back the frames of every client
+    (the server only skips it once this process has exited).
+    This class is not thread-safe (use one client per thread) and non-copyable.
+    */
+    class FrameClient {
+        public:
+            FrameClient();
+            FrameClient(const FrameClient& other) = delete;
+            FrameClient& operator=(const FrameClient& other) = delete;
+            ~FrameClient();
+
+            /*
+            Connect to the server named serverName. Return false if it is not running or has no free client entry.
+            */
+            bool connect(const std::string& serverName = "facemesh");
+
+            /*
+            Free the client entry (results still in flight are discarded)
+            */
+            void disconnect();
+
+            bool isConnected() const;
+
+            /*
+            Reserve a request slot for a frame of format and size. Return where to write the pixels
+            (getFrameBytes() bytes, rows of getFrameStride() bytes), or nullptr if every slot is in use
+            or the frame is larger than getMaxFrameBytes().
+            Every acquired frame must be submitted before the next acquireFrame().
+            */
+            uint8_t* acquireFrame(FrameFormat format, uint32_t width, uint32_t height);
+
+            /*
+            Hand the acquired frame to the server
+            */
+            void submitFrame(uint64_t frameId, int64_t timestamp = 0);
+
+            /*
+            Wait at most about timeoutMs for the next result (0: do not wait). Return nullptr on timeout.
+            The result stays valid until releaseResult(), which must be called before the next acquireResult().
+            */
+            const SharedResult* acquireResult(int timeoutMs);
+            void releaseResult();
+
+            /*
+            Largest frame the server accepts, in bytes
+            */
+            size_t getMaxFrameBytes() const;
+
+            /*
+            Results dropped by the server because the result ring of this client was full
+            */
+            uint64_t getDroppedResults() const;
+
+
+        private:
+            std::unique_ptr<SharedMemory> m_memory;
+            std::unique_ptr<NamedSemaphore> m_requestSemaphore;
+            std::unique_ptr<NamedSemaphore> m_resultSemaphore;
+            FrameServerControl* m_control;
+            SharedRing m_requests;
+            SharedRing m_results;
+            uint32_t m_clientId;
+            uint32_t m_session;
+            SharedFrameHeader* m_pendingFrame;
+            uint64_t m_pendingTicket;
+            bool m_hasResult;
+            uint64_t m_resultTicket;
+    };
+}
+
+#endif // FRAMECLIENT_H
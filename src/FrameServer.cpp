@@ -0,0 +1,358 @@
+#include "FrameServer.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#define FRAME_SERVER_POLL_MS    100     // how often idle workers check stop() and reclaim stale clients
+#define FRAME_SERVER_SPIN_LIMIT 256     // yields waiting for the oldest request slot before giving a post up
+#define FRAME_SERVER_STALE_MS   1000    // age of an unpublished request slot before it can be skipped
+
+/*
+Helper functions
+*/
+uint32_t roundUpToPowerOfTwo(int value) {
+    uint32_t result = 1;
+    while (result < (uint32_t)std::max(value, 1)) result <<= 1;
+    return result;
+}
+
+
+my::FrameServerOptions resolveFrameServerOptions(my::FrameServerOptions options) {
+    options.numWorkers = std::max(options.numWorkers, 1);
+    options.frameSlots = (int)roundUpToPowerOfTwo(std::max(options.frameSlots, options.numWorkers));
+    options.resultSlots = (int)roundUpToPowerOfTwo(options.resultSlots);
+    options.maxClients = std::min(std::max(options.maxClients, 1), FRAME_SERVER_MAX_CLIENTS);
+    if (options.eyeRoiSource == my::EyeRoiSource::PreviousFrame)
+        options.eyeRoiSource = my::EyeRoiSource::Detection;
+    return options;
+}
+
+
+void writeRoi(const cv::Rect& roi, float* out) {
+    out[0] = (float)roi.x;
+    out[1] = (float)roi.y;
+    out[2] = (float)roi.width;
+    out[3] = (float)roi.height;
+}
+
+
+my::FrameServer::FrameServer(std::string modelPath, const FrameServerOptions& options):
+    m_options(resolveFrameServerOptions(options)),
+    m_control(nullptr),
+    m_stopped(false),
+    m_framesProcessed(0),
+    m_invalidFrames(0),
+    m_owedFrames(0),
+    m_skippedPosts(0),
+    m_reclaimedClients(0),
+    m_reclaimedFrames(0),
+    m_lastReclaim(std::chrono::steady_clock::now()),
+    m_hasStalledSlot(false),
+    m_stalledTicket(0)
+{
+    for (int i = 0; i < m_options.numWorkers; ++i) {
+        m_pipelines.emplace_back(new IrisLandmark(modelPath, false, m_options.pipeline));
+        m_pipelines.back()->setEyeRoiSource(m_options.eyeRoiSource);
+    }
+
+    FrameServerControl layout;
+    computeFrameServerLayout(layout, m_options.frameSlots, m_options.maxFrameBytes,
+        m_options.resultSlots, m_options.maxClients);
+
+    /*
+    The shared memory is formatted before the semaphores exist and isRunning is set,
+    so a client never sees a partly written layout
+    */
+    m_memory.reset(new SharedMemory(m_options.name, layout.totalBytes, true));
+    if (!m_memory->isOpened()) {
+        std::cerr << "Cannot create shared memory " << m_options.name << "." << std::endl;
+        return;
+    }
+
+    uint8_t* data = m_memory->getData();
+    m_control = new (data) FrameServerControl();
+    computeFrameServerLayout(*m_control, m_options.frameSlots, m_options.maxFrameBytes,
+        m_options.resultSlots, m_options.maxClients);
+    m_control->magic = FRAME_SERVER_MAGIC;
+    m_control->version = FRAME_SERVER_VERSION;
+
+    m_requests.initialize(data + m_control->requestRingOffset, m_control->frameSlots,
+        FRAME_DATA_OFFSET + m_control->maxFrameBytes);
+    m_resultRings.resize(m_control->maxClients);
+    for (uint32_t i = 0; i < m_control->maxClients; ++i) {
+        m_resultRings[i].initialize(data + m_control->resultRingOffset + i * m_control->resultRingBytes,
+            m_control->resultSlots, sizeof(SharedResult));
+    }
+
+    m_requestSemaphore.reset(new NamedSemaphore(getRequestSemaphoreName(m_options.name), true));
+    for (uint32_t i = 0; i < m_control->maxClients; ++i) {
+        m_resultSemaphores.emplace_back(new NamedSemaphore(getResultSemaphoreName(m_options.name, i), true));
+    }
+    if (!isOpened()) {
+        std::cerr << "Cannot create the semaphores of " << m_options.name << "." << std::endl;
+        return;
+    }
+
+    m_control->isRunning.store(1, std::memory_order_release);
+}
+
+
+my::FrameServer::~FrameServer() {
+    stop();
+    if (m_control != nullptr)
+        m_control->isRunning.store(0);
+}
+
+
+bool my::FrameServer::isOpened() const {
+    if (m_control == nullptr || !m_requestSemaphore || !m_requestSemaphore->isOpened())
+        return false;
+
+    for (auto& semaphore : m_resultSemaphores) {
+        if (!semaphore->isOpened()) return false;
+    }
+    return true;
+}
+
+
+void my::FrameServer::run() {
+    if (!isOpened()) return;
+
+    std::vector<std::thread> threads;
+    for (int i = 1; i < m_options.numWorkers; ++i) {
+        threads.emplace_back(&FrameServer::runWorker, this, i);
+    }
+    runWorker(0);
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+
+void my::FrameServer::stop() {
+    m_stopped = true;
+}
+
+
+my::FrameServerStats my::FrameServer::getStats() const {
+    FrameServerStats stats;
+    stats.framesProcessed = m_framesProcessed.load();
+    stats.invalidFrames = m_invalidFrames.load();
+    stats.skippedPosts = m_skippedPosts.load();
+    stats.reclaimedClients = m_reclaimedClients.load();
+    stats.reclaimedFrames = m_reclaimedFrames.load();
+    if (m_control != nullptr) {
+        for (uint32_t i = 0; i < m_control->maxClients; ++i) {
+            stats.droppedResults += (long long)m_control->droppedResults[i].load();
+        }
+    }
+    return stats;
+}
+
+//-------------------Private methods start here-------------------
+
+void my::FrameServer::runWorker(int index) {
+    auto& pipeline = *m_pipelines[index];
+
+    while (!m_stopped) {
+        bool isPosted = m_requestSemaphore->wait(FRAME_SERVER_POLL_MS);
+
+        uint64_t ticket;
+        uint8_t* payload = acquireRequest(ticket, isPosted);
+        while (payload != nullptr) {
+            processFrame(pipeline, payload, ticket);
+            payload = acquireRequest(ticket, false);
+        }
+        reclaimStaleClients();
+    }
+}
+
+
+uint8_t* my::FrameServer::acquireRequest(uint64_t& ticket, bool isPosted) {
+    /*
+    Without a post, only a frame owed by a post given up earlier may be taken
+    */
+    if (!isPosted) {
+        long long owed = m_owedFrames.load();
+        do {
+            if (owed <= 0) return nullptr;
+        } while (!m_owedFrames.compare_exchange_weak(owed, owed - 1));
+    }
+
+    /*
+    Each post follows a publish, but the oldest slot may still be written by another client
+    (the frame of this post is then behind it): wait for it a little, never unboundedly,
+    as that client may be gone
+    */
+    uint8_t* payload = static_cast<uint8_t*>(m_requests.tryAcquireRead(ticket));
+    for (int i = 0; payload == nullptr && isPosted && i < FRAME_SERVER_SPIN_LIMIT; ++i) {
+        std::this_thread::yield();
+        payload = static_cast<uint8_t*>(m_requests.tryAcquireRead(ticket));
+    }
+
+    if (payload == nullptr) {
+        m_owedFrames++;
+        if (isPosted) m_skippedPosts++;
+    }
+    return payload;
+}
+
+
+void my::FrameServer::reclaimStaleClients() {
+    std::unique_lock<std::mutex> lock(m_reclaimMutex, std::try_to_lock);
+    if (!lock.owns_lock()) return;
+
+    auto now = std::chrono::steady_clock::now();
+    if (now - m_lastReclaim < std::chrono::milliseconds(FRAME_SERVER_POLL_MS)) return;
+    m_lastReclaim = now;
+
+    for (uint32_t i = 0; i < m_control->maxClients; ++i) {
+        uint64_t owner = m_control->clientOwners[i].load();
+        if (owner == 0 || isProcessAlive(getOwnerProcess(owner))) continue;
+
+        if (m_control->clientOwners[i].compare_exchange_strong(owner, 0)) {
+            m_control->droppedResults[i].store(0);
+            m_reclaimedClients++;
+        }
+    }
+
+    /*
+    The oldest slot, acquired but not published for FRAME_SERVER_STALE_MS, is skipped when no live client
+    owns it (the server clears the session of every slot it releases, so a client that exited before writing
+    the header leaves session 0). It is published as an invalid frame, whose result nobody reads.
+    */
+    uint64_t ticket;
+    auto header = static_cast<SharedFrameHeader*>(m_requests.getUnpublishedHead(ticket));
+    if (header == nullptr || !m_hasStalledSlot || ticket != m_stalledTicket) {
+        m_hasStalledSlot = header != nullptr;
+        m_stalledTicket = ticket;
+        m_stalledSince = now;
+        return;
+    }
+
+    if (now - m_stalledSince < std::chrono::milliseconds(FRAME_SERVER_STALE_MS) || isSessionOwned(header->session))
+        return;
+
+    header->width = 0;
+    header->session = 0;
+    if (m_requests.forcePublish(ticket)) {
+        m_reclaimedFrames++;
+        m_requestSemaphore->post();
+    }
+    m_hasStalledSlot = false;
+}
+
+
+bool my::FrameServer::isSessionOwned(uint32_t session) const {
+    if (session == 0) return false;
+
+    for (uint32_t i = 0; i < m_control->maxClients; ++i) {
+        if (getOwnerSession(m_control->clientOwners[i].load()) == session) return true;
+    }
+    return false;
+}
+
+
+void my::FrameServer::processFrame(IrisLandmark& pipeline, uint8_t* payload, uint64_t ticket) {
+    auto header = *reinterpret_cast<const SharedFrameHeader*>(payload);
+
+    cv::Mat image;
+    PixelFormat format;
+    bool isValid = wrapFrame(header, payload + FRAME_DATA_OFFSET, image, format);
+    if (isValid) {
+        if (pipeline.getPixelFormat() != format)
+            pipeline.setPixelFormat(format);
+
+        pipeline.loadImageToInput(image);
+        pipeline.runInference();
+        m_framesProcessed++;
+    }
+    else {
+        m_invalidFrames++;
+    }
+
+    /*
+    The pixels are not read after inference: the slot goes back to the clients before the result is written.
+    Its session is cleared, so a client that exits right after acquiring it is not taken for its previous owner.
+    */
+    reinterpret_cast<SharedFrameHeader*>(payload)->session = 0;
+    m_requests.release(ticket);
+    writeResult(pipeline, header, isValid);
+}
+
+
+bool my::FrameServer::wrapFrame(const SharedFrameHeader& header, uint8_t* pixels, cv::Mat& image, PixelFormat& format) const {
+    size_t bytes = getFrameBytes(header.format, header.width, header.height);
+    if (bytes == 0 || bytes > m_control->maxFrameBytes || header.stride != getFrameStride(header.format, header.width))
+        return false;
+
+    int rows = (int)header.height;
+    int cols = (int)header.width;
+    switch (header.format) {
+        case FrameFormat::BGR:
+            image = cv::Mat(rows, cols, CV_8UC3, pixels, header.stride);
+            format = PixelFormat::BGR;
+            break;
+        case FrameFormat::BGRA:
+            image = cv::Mat(rows, cols, CV_8UC4, pixels, header.stride);
+            format = PixelFormat::BGR;
+            break;
+        case FrameFormat::NV12:
+            image = cv::Mat(rows * 3 / 2, cols, CV_8UC1, pixels, header.stride);
+            format = PixelFormat::NV12;
+            break;
+        case FrameFormat::I420:
+            image = cv::Mat(rows * 3 / 2, cols, CV_8UC1, pixels, header.stride);
+            format = PixelFormat::I420;
+            break;
+        case FrameFormat::YUYV:
+            image = cv::Mat(rows, cols, CV_8UC2, pixels, header.stride);
+            format = PixelFormat::YUYV;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+
+void my::FrameServer::writeResult(const IrisLandmark& pipeline, const SharedFrameHeader& header, bool isValid) {
+    uint32_t clientId = header.clientId;
+    if (clientId >= m_control->maxClients)
+        return;
+
+    /*
+    Nobody would read the result of a client that disconnected
+    */
+    if (getOwnerSession(m_control->clientOwners[clientId].load()) != header.session)
+        return;
+
+    uint64_t ticket;
+    auto& results = m_resultRings[clientId];
+    auto result = static_cast<SharedResult*>(results.tryAcquireWrite(ticket));
+    if (result == nullptr) {
+        m_control->droppedResults[clientId].fetch_add(1);
+        return;
+    }
+
+    result->frameId = header.frameId;
+    result->timestamp = header.timestamp;
+    result->session = header.session;
+    result->status = isValid ? FrameStatus::Ok : FrameStatus::InvalidFrame;
+    result->presence = isValid ? pipeline.getFacePresence() : 0.f;
+    result->numFaceLandmarks = isValid ? pipeline.getAllFaceLandmarks(result->faceLandmarks) : 0;
+    if (result->numFaceLandmarks > 0) {
+        writeRoi(pipeline.getFaceRoi(), result->faceRoi);
+        for (int i = 0; i < 2; ++i) {
+            bool isLeftEye = i == 0;
+            writeRoi(pipeline.getEyeRoi(isLeftEye), result->eyeRois[i]);
+            pipeline.getAllEyeLandmarks(isLeftEye, false, result->eyeLandmarks[i]);
+            pipeline.getAllEyeLandmarks(isLeftEye, true, result->irisLandmarks[i]);
+        }
+    }
+
+    results.publish(ticket);
+    m_resultSemaphores[clientId]->post();
+}
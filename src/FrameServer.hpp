@@ -0,0 +1,154 @@
+#ifndef FRAMESERVER_H
+#define FRAMESERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "IrisLandmark.hpp"
+#include "FrameServerProtocol.hpp"
+#include "SharedMemory.hpp"
+#include "SharedRing.hpp"
+
+namespace my {
+
+    /*
+    Settings of a FrameServer.
+    Attributes:
+        name: name of the shared memory and semaphores, clients connect with it
+        numWorkers: pipelines running frames at the same time (each one loads its own interpreters)
+        frameSlots: request ring capacity, shared by all clients (rounded up to a power of 2)
+        maxFrameBytes: largest frame accepted (default: 1080p BGRA)
+        resultSlots: result ring capacity of each client (rounded up to a power of 2)
+        maxClients: client entries (at most FRAME_SERVER_MAX_CLIENTS)
+        eyeRoiSource: see EyeRoiSource (PreviousFrame is replaced by Detection: frames of all clients are mixed)
+    */
+    struct FrameServerOptions {
+        std::string name = "facemesh";
+        int numWorkers = 1;
+        int frameSlots = 8;
+        size_t maxFrameBytes = 1920 * 1080 * 4;
+        int resultSlots = 16;
+        int maxClients = 8;
+        EyeRoiSource eyeRoiSource = EyeRoiSource::FaceMesh;
+        PipelineOptions pipeline;
+    };
+
+    /*
+    Counters of a FrameServer
+    Attributes:
+        skippedPosts: wake-ups given up because the oldest request slot was not published yet
+                      (its frame is taken later, see FrameServer)
+        reclaimedClients: client entries freed because their process exited
+        reclaimedFrames: request slots skipped because their client exited before submitting them
+    */
+    struct FrameServerStats {
+        long long framesProcessed = 0;
+        long long invalidFrames = 0;
+        long long droppedResults = 0;
+        long long skippedPosts = 0;
+        long long reclaimedClients = 0;
+        long long reclaimedFrames = 0;
+    };
+
+    /*
+    A daemon owning the models, serving the processes of the host through shared memory:
+    clients write frames in place into a lock-free request ring (see FrameClient),
+    the workers run the pipeline directly on the shared pixels (no copy, YUV frames are not converted)
+    and write the landmarks into the result ring of the client, then post its semaphore.
+    Each worker has its own pipeline without tracking, as consecutive frames may come from different clients.
+    Clients that crash are cleaned up: the entries of processes that exited are freed, and a request slot
+    they acquired without submitting is skipped after FRAME_SERVER_STALE_MS (it would block every client).
+    This class is non-copyable.
+    */
+    class FrameServer {
+        public:
+            /*
+            modelPath: FOLDER of the models (see IrisLandmark)
+            */
+            FrameServer(std::string modelPath, const FrameServerOptions& options = FrameServerOptions());
+            FrameServer(const FrameServer& other) = delete;
+            FrameServer& operator=(const FrameServer& other) = delete;
+            ~FrameServer();
+
+            /*
+            Check if the shared memory and semaphores were created
+            */
+            bool isOpened() const;
+
+            /*
+            Serve frames until stop() (numWorkers - 1 threads are started, the caller is the last worker)
+            */
+            void run();
+
+            /*
+            Make run() return (safe to call from a signal handler or another thread)
+            */
+            void stop();
+
+            FrameServerStats getStats() const;
+
+
+        private:
+            void runWorker(int index);
+
+            /*
+            Take a request slot for a post of the request semaphore (isPosted) or for a frame owed by a post
+            given up earlier. Return nullptr if the oldest slot is not published (the frame becomes owed).
+            */
+            uint8_t* acquireRequest(uint64_t& ticket, bool isPosted);
+
+            /*
+            Free the client entries of processes that exited and skip a request slot they left acquired.
+            Runs at most once per FRAME_SERVER_POLL_MS, on one worker.
+            */
+            void reclaimStaleClients();
+
+            /*
+            Check if a live client entry has this session
+            */
+            bool isSessionOwned(uint32_t session) const;
+
+            /*
+            Run the pipeline on the frame of a request slot, release the slot and write the result
+            */
+            void processFrame(IrisLandmark& pipeline, uint8_t* payload, uint64_t ticket);
+
+            /*
+            Wrap the pixels of a request slot in a Mat of the matching pixel format (false if the header is invalid)
+            */
+            bool wrapFrame(const SharedFrameHeader& header, uint8_t* pixels, cv::Mat& image, PixelFormat& format) const;
+
+            void writeResult(const IrisLandmark& pipeline, const SharedFrameHeader& header, bool isValid);
+
+            FrameServerOptions m_options;
+            std::unique_ptr<SharedMemory> m_memory;
+            std::unique_ptr<NamedSemaphore> m_requestSemaphore;
+            std::vector<std::unique_ptr<NamedSemaphore>> m_resultSemaphores;
+            FrameServerControl* m_control;
+            SharedRing m_requests;
+            std::vector<SharedRing> m_resultRings;
+            std::vector<std::unique_ptr<IrisLandmark>> m_pipelines;
+
+            std::atomic<bool> m_stopped;
+            std::atomic<long long> m_framesProcessed;
+            std::atomic<long long> m_invalidFrames;
+            std::atomic<long long> m_owedFrames;
+            std::atomic<long long> m_skippedPosts;
+            std::atomic<long long> m_reclaimedClients;
+            std::atomic<long long> m_reclaimedFrames;
+
+            /*
+            Reclaim state (guarded by m_reclaimMutex)
+            */
+            std::mutex m_reclaimMutex;
+            std::chrono::steady_clock::time_point m_lastReclaim;
+            bool m_hasStalledSlot;
+            uint64_t m_stalledTicket;
+            std::chrono::steady_clock::time_point m_stalledSince;
+    };
+}
+
+#endif // FRAMESERVER_H
@@ -0,0 +1,180 @@
+#ifndef FRAMESERVERPROTOCOL_H
+#define FRAMESERVERPROTOCOL_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "SharedRing.hpp"
+
+#define FRAME_SERVER_MAGIC          0x464D5346u     // "FSMF"
+#define FRAME_SERVER_VERSION        1
+#define FRAME_SERVER_MAX_CLIENTS    32
+#define FRAME_DATA_OFFSET           64              // pixels start after the frame header in a request slot
+#define RESULT_FACE_LANDMARKS       468
+#define RESULT_EYE_LANDMARKS        71
+#define RESULT_IRIS_LANDMARKS       5
+
+namespace my {
+
+    /*
+    Shared memory layout of a frame server named N (see FrameServer and FrameClient):
+        shared memory N: FrameServerControl, the request ring, then one result ring per client entry
+        semaphore N_req: posted by clients after each frame they submit
+        semaphore N_res<i>: posted by the server after each result it writes for client entry i
+    Everything here is plain data: it must not depend on OpenCV, so clients link only FaceMeshClient.
+    */
+
+    /*
+    Pixel layout of a submitted frame (stride: bytes per row of the first plane):
+        BGR, BGRA: packed, 3 or 4 bytes per pixel
+        NV12, I420: the Y plane then the chroma at half resolution (rows must be packed: stride == width)
+        YUYV: packed, 2 bytes per pixel (Y0 U Y1 V)
+    YUV frames must have an even width and height.
+    */
+    enum class FrameFormat : uint32_t {
+        BGR,
+        BGRA,
+        NV12,
+        I420,
+        YUYV
+    };
+
+    /*
+    Status of a SharedResult
+    */
+    enum class FrameStatus : int32_t {
+        Ok,
+        InvalidFrame
+    };
+
+    /*
+    Header of a request slot, followed by the pixels at FRAME_DATA_OFFSET
+    */
+    struct SharedFrameHeader {
+        uint64_t frameId;
+        int64_t timestamp;
+        uint32_t clientId;
+        uint32_t session;
+        FrameFormat format;
+        uint32_t width;
+        uint32_t height;
+        uint32_t stride;
+    };
+
+    static_assert(sizeof(SharedFrameHeader) <= FRAME_DATA_OFFSET, "SharedFrameHeader overlaps the pixels");
+
+    /*
+    Result of one frame, in pixels of the submitted frame.
+    Rois are x, y, width, height. Landmarks are x, y, z of each point (eyes: left then right).
+    Without face, numFaceLandmarks is 0 and the other fields are undefined.
+    */
+    struct SharedResult {
+        uint64_t frameId;
+        int64_t timestamp;
+        uint32_t session;
+        FrameStatus status;
+        float presence;
+        int32_t numFaceLandmarks;
+        float faceRoi[4];
+        float eyeRois[2][4];
+        float faceLandmarks[RESULT_FACE_LANDMARKS * 3];
+        float eyeLandmarks[2][RESULT_EYE_LANDMARKS * 3];
+        float irisLandmarks[2][RESULT_IRIS_LANDMARKS * 3];
+    };
+
+    /*
+    Start of the shared memory, written by the server before the clients can open it.
+    clientOwners[i] is the process and session of the client owning entry i (0: free entry, see makeClientOwner),
+    claimed in one atomic step so the server can always free the entries of processes that exited.
+    */
+    struct FrameServerControl {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t frameSlots;
+        uint32_t resultSlots;
+        uint32_t maxClients;
+        uint32_t reserved;
+        uint64_t maxFrameBytes;
+        uint64_t requestRingOffset;
+        uint64_t resultRingOffset;
+        uint64_t resultRingBytes;
+        uint64_t totalBytes;
+        std::atomic<uint32_t> isRunning;
+        std::atomic<uint32_t> nextSession;
+        std::atomic<uint64_t> clientOwners[FRAME_SERVER_MAX_CLIENTS];
+        std::atomic<uint64_t> droppedResults[FRAME_SERVER_MAX_CLIENTS];
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "FrameServerControl needs lock-free atomics");
+
+    inline uint64_t makeClientOwner(uint32_t pid, uint32_t session) {
+        return ((uint64_t)pid << 32) | session;
+    }
+
+    inline uint32_t getOwnerProcess(uint64_t owner) {
+        return (uint32_t)(owner >> 32);
+    }
+
+    inline uint32_t getOwnerSession(uint64_t owner) {
+        return (uint32_t)owner;
+    }
+
+    /*
+    Bytes of a frame of format (0 if the size is not valid for the format)
+    */
+    inline size_t getFrameBytes(FrameFormat format, uint32_t width, uint32_t height) {
+        if (width == 0 || height == 0) return 0;
+        size_t pixels = (size_t)width * height;
+        switch (format) {
+            case FrameFormat::BGR: return pixels * 3;
+            case FrameFormat::BGRA: return pixels * 4;
+            case FrameFormat::NV12:
+            case FrameFormat::I420: return (width % 2 || height % 2) ? 0 : pixels * 3 / 2;
+            case FrameFormat::YUYV: return width % 2 ? 0 : pixels * 2;
+        }
+        return 0;
+    }
+
+    /*
+    Bytes per row of the first plane of a packed frame of format
+    */
+    inline uint32_t getFrameStride(FrameFormat format, uint32_t width) {
+        switch (format) {
+            case FrameFormat::BGR: return width * 3;
+            case FrameFormat::BGRA: return width * 4;
+            case FrameFormat::YUYV: return width * 2;
+            default: return width;
+        }
+    }
+
+    /*
+    Fill the geometry of control (offsets aligned for SharedRing) for the given ring sizes
+    */
+    inline void computeFrameServerLayout(FrameServerControl& control, uint32_t frameSlots, uint64_t maxFrameBytes,
+        uint32_t resultSlots, uint32_t maxClients)
+    {
+        auto align = [](uint64_t bytes) {
+            return (bytes + SHARED_RING_ALIGNMENT - 1) / SHARED_RING_ALIGNMENT * SHARED_RING_ALIGNMENT;
+        };
+        control.frameSlots = frameSlots;
+        control.resultSlots = resultSlots;
+        control.maxClients = maxClients;
+        control.maxFrameBytes = maxFrameBytes;
+        control.requestRingOffset = align(sizeof(FrameServerControl));
+        control.resultRingOffset = control.requestRingOffset +
+            align(SharedRing::getRequiredBytes(frameSlots, FRAME_DATA_OFFSET + maxFrameBytes));
+        control.resultRingBytes = align(SharedRing::getRequiredBytes(resultSlots, sizeof(SharedResult)));
+        control.totalBytes = control.resultRingOffset + control.resultRingBytes * maxClients;
+    }
+
+    inline std::string getRequestSemaphoreName(const std::string& serverName) {
+        return serverName + "_req";
+    }
+
+    inline std::string getResultSemaphoreName(const std::string& serverName, uint32_t clientId) {
+        return serverName + "_res" + std::to_string(clientId);
+    }
+}
+
+#endif // FRAMESERVERPROTOCOL_H
@@ -0,0 +1,83 @@
+#ifndef HALFFLOAT_H
+#define HALFFLOAT_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace my {
+
+    /*
+    Convert float to IEEE 754 half precision bits (round to nearest)
+    */
+    inline uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint32_t sign = (bits >> 16) & 0x8000;
+        int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+        uint32_t mantissa = bits & 0x7fffff;
+
+        if (((bits >> 23) & 0xff) == 0xff)
+            return (uint16_t)(sign | 0x7c00 | (mantissa ? 0x200 : 0)); // inf or nan
+        if (exponent >= 31) 
+            return (uint16_t)(sign | 0x7c00); // overflow to inf
+        if (exponent <= 0) {
+            /*
+            Subnormal half (or zero when too small)
+            */
+            if (exponent < -10) return (uint16_t)sign;
+            mantissa |= 0x800000;
+            int shift = 14 - exponent;
+            uint32_t half = mantissa >> shift;
+            if ((mantissa >> (shift - 1)) & 1) half += 1;
+            return (uint16_t)(sign | half);
+        }
+
+        /*
+        Rounding may carry into the exponent, which is still the correct result
+        */
+        uint32_t half = sign | ((uint32_t)exponent << 10) | (mantissa >> 13);
+        if (mantissa & 0x1000) half += 1;
+        return (uint16_t)half;
+    }
+
+
+    /*
+    Convert IEEE 754 half precision bits to float
+    */
+    inline float halfToFloat(uint16_t half) {
+        uint32_t sign = (uint32_t)(half & 0x8000) << 16;
+        int exponent = (half >> 10) & 0x1f;
+        uint32_t mantissa = half & 0x3ff;
+        uint32_t bits;
+
+        if (exponent == 0) {
+            if (mantissa == 0) {
+                bits = sign;
+            }
+            else {
+                /*
+                Normalize the subnormal half
+                */
+                exponent = 1;
+                while ((mantissa & 0x400) == 0) {
+                    mantissa <<= 1;
+                    --exponent;
+                }
+                bits = sign | ((uint32_t)(exponent + 112) << 23) | ((mantissa & 0x3ff) << 13);
+            }
+        }
+        else if (exponent == 31) {
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        }
+        else {
+            bits = sign | ((uint32_t)(exponent + 112) << 23) | (mantissa << 13);
+        }
+
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+}
+
+#endif // HALFFLOAT_H
@@ -0,0 +1,120 @@
+#include "InterpreterOptions.hpp"
+#include "ModelLoader.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+/*
+Helper functions
+*/
+std::string getTuningKey(const std::string& modelPath, const my::InterpreterOptions& options) {
+    std::error_code error;
+    auto path = std::filesystem::weakly_canonical(modelPath, error);
+    return (error ? modelPath : path.string()) + "|" + std::to_string((int)options.delegate) + "|" 
+        + std::to_string(options.numThreads) + "|" + std::to_string(options.allowDynamicTensors);
+}
+
+
+std::vector<int> getThreadCandidates() {
+    int maxThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    std::vector<int> candidates;
+    for (int n = 1; n < maxThreads; n *= 2) {
+        candidates.push_back(n);
+    }
+    candidates.push_back(maxThreads);
+    return candidates;
+}
+
+
+my::InterpreterTuner& my::InterpreterTuner::getInstance() {
+    static InterpreterTuner instance;
+    return instance;
+}
+
+
+my::InterpreterOptions my::InterpreterTuner::resolve(const std::string& modelPath, const InterpreterOptions& options) {
+    if (!options.isAuto()) return options;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto key = getTuningKey(modelPath, options);
+    auto it = m_tuned.find(key);
+    if (it != m_tuned.end()) return it->second;
+
+    /*
+    Tuning under the lock: loaders of the same model built concurrently wait for one result
+    */
+    auto tuned = tune(modelPath, options);
+    m_tuned[key] = tuned;
+    return tuned;
+}
+
+
+my::InterpreterOptions my::InterpreterTuner::tune(const std::string& modelPath, const InterpreterOptions& options) {
+    std::vector<DelegateType> delegates = {options.delegate};
+    if (options.delegate == DelegateType::Auto) 
+        delegates = {DelegateType::Builtin, DelegateType::XNNPack};
+
+    std::vector<int> threads = {options.numThreads};
+    if (options.numThreads == AUTO_THREADS) 
+        threads = getThreadCandidates();
+
+    InterpreterOptions best = options;
+    double bestLatency = -1.;
+    for (auto delegate : delegates) {
+        for (int numThreads : threads) {
+            InterpreterOptions candidate = options;
+            candidate.delegate = delegate;
+            candidate.numThreads = numThreads;
+
+            /*
+            Keep what was applied: XNNPACK falls back to builtin ops on models it cannot run
+            */
+            InterpreterOptions applied;
+            double latency = measure(modelPath, candidate, applied);
+            if (bestLatency < 0. || latency < bestLatency) {
+                best = applied;
+                bestLatency = latency;
+            }
+        }
+    }
+    return best;
+}
+
+//-------------------Private methods start here-------------------
+
+double my::InterpreterTuner::measure(const std::string& modelPath, const InterpreterOptions& candidate, 
+    InterpreterOptions& applied) const 
+{
+    ModelLoader model(modelPath, candidate);
+    applied = model.getInterpreterOptions();
+
+    std::vector<std::vector<char>> inputs(model.getNumberOfInputs());
+    for (int i = 0; i < (int)inputs.size(); ++i) {
+        inputs[i].assign(model.getInputSize(i), 0);
+    }
+
+    auto runOnce = [&model, &inputs]() {
+        for (int i = 0; i < (int)inputs.size(); ++i) {
+            model.loadRawToInput(inputs[i].data(), inputs[i].size(), i);
+        }
+        model.runInference();
+    };
+
+    for (int i = 0; i < TUNE_WARMUP_RUNS; ++i) {
+        runOnce();
+    }
+
+    std::vector<double> latencies(TUNE_TIMED_RUNS);
+    for (auto& latency : latencies) {
+        auto start = std::chrono::steady_clock::now();
+        runOnce();
+        auto stop = std::chrono::steady_clock::now();
+        latency = std::chrono::duration<double, std::micro>(stop - start).count();
+    }
+
+    std::nth_element(latencies.begin(), latencies.begin() + latencies.size() / 2, latencies.end());
+    return latencies[latencies.size() / 2];
+}
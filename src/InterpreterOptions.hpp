@@ -0,0 +1,101 @@
+#ifndef INTERPRETEROPTIONS_H
+#define INTERPRETEROPTIONS_H
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "AnchorConfig.hpp"
+
+#define AUTO_THREADS        0
+#define TUNE_WARMUP_RUNS    3
+#define TUNE_TIMED_RUNS     10
+
+namespace my {
+
+    /*
+    How the operators of a model are executed.
+        Auto: chosen by InterpreterTuner (opt-in, see InterpreterTuner)
+        Builtin: plain tflite kernels
+        XNNPack: XNNPACK delegate (falls back to Builtin if the model cannot be delegated)
+    */
+    enum class DelegateType {
+        Auto,
+        Builtin,
+        XNNPack
+    };
+
+    /*
+    Settings of one tflite interpreter.
+    Attributes:
+        delegate: see DelegateType
+        numThreads: intra-op threads (AUTO_THREADS: chosen by InterpreterTuner, -1: tflite default, 
+                    XNNPACK runs single-threaded below 1)
+        allowDynamicTensors: allocate large tensors at runtime (and release them after use) 
+                             instead of keeping them in the arena. Lowers peak memory, costs some speed.
+    */
+    struct InterpreterOptions {
+        DelegateType delegate = DelegateType::XNNPack;
+        int numThreads = -1;
+        bool allowDynamicTensors = false;
+
+        /*
+        True if the tuner has to fill some attributes
+        */
+        bool isAuto() const { return delegate == DelegateType::Auto || numThreads == AUTO_THREADS; }
+    };
+
+    /*
+    Interpreter settings of each stage of the pipeline, and the face detector to load
+    */
+    struct PipelineOptions {
+        InterpreterOptions detection;
+        InterpreterOptions landmark;
+        InterpreterOptions iris;
+        DetectorRange detectorRange = DetectorRange::Short;
+    };
+
+    /*
+    Pick the fastest delegate/thread count of a model on this machine.
+    Every candidate runs TUNE_TIMED_RUNS inferences on a zero input, the lowest median wins.
+    Results are cached per model file, so a model is tuned at most once per process.
+    Tuning is opt-in (set Auto explicitly): every candidate costs TUNE_WARMUP_RUNS + TUNE_TIMED_RUNS inferences 
+    at startup, and each model is timed alone, so the winners of models running at the same time 
+    (stream/frame server workers) can oversubscribe the CPU together.
+    This class is thread-safe.
+    */
+    class InterpreterTuner {
+        public:
+            static InterpreterTuner& getInstance();
+
+            InterpreterTuner(const InterpreterTuner& other) = delete;
+            InterpreterTuner& operator=(const InterpreterTuner& other) = delete;
+
+            /*
+            Return options with every Auto attribute replaced by the tuned value
+            */
+            InterpreterOptions resolve(const std::string& modelPath, const InterpreterOptions& options);
+
+            /*
+            Tune a model now (ignoring the cache), explicit attributes of options are kept.
+            */
+            InterpreterOptions tune(const std::string& modelPath, const InterpreterOptions& options);
+
+
+        private:
+            InterpreterTuner() = default;
+
+            /*
+            Median latency of one candidate in microseconds, applied: the options the interpreter actually ran with
+            */
+            double measure(const std::string& modelPath, const InterpreterOptions& candidate, 
+                InterpreterOptions& applied) const;
+
+
+        private:
+            std::mutex m_mutex;
+            std::map<std::string, InterpreterOptions> m_tuned;
+    };
+}
+
+#endif // INTERPRETEROPTIONS_H
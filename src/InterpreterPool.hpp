@@ -0,0 +1,98 @@
+#ifndef INTERPRETERPOOL_H
+#define INTERPRETERPOOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace my {
+
+    /*
+    A fixed pool of interpreters (ModelLoader or any of its subclasses) of the same model.
+    An interpreter cannot run two inferences at once, so jobs lease one for the duration
+    of their inference and give it back when the Lease is destroyed.
+    The models themselves are shared through ModelRegistry, so each extra interpreter
+    only costs its activations.
+    This class is thread-safe and non-copyable.
+    */
+    template <class T>
+    class InterpreterPool {
+        public:
+            typedef std::function<std::unique_ptr<T>()> Factory;
+
+            /*
+            Exclusive access to one interpreter of the pool (move-only)
+            */
+            class Lease {
+                public:
+                    Lease(InterpreterPool* pool, T* object): m_pool(pool), m_object(object) {}
+                    Lease(Lease&& other): m_pool(other.m_pool), m_object(other.m_object) {
+                        other.m_object = nullptr;
+                    }
+                    Lease(const Lease& other) = delete;
+                    Lease& operator=(const Lease& other) = delete;
+                    ~Lease() {
+                        if (m_object) m_pool->release(m_object);
+                    }
+
+                    T* operator->() const { return m_object; }
+                    T& operator*() const { return *m_object; }
+
+                private:
+                    InterpreterPool* m_pool;
+                    T* m_object;
+            };
+
+            /*
+            Build size interpreters up front with factory
+            */
+            InterpreterPool(int size, Factory factory) {
+                for (int i = 0; i < std::max(size, 1); ++i) {
+                    m_objects.push_back(factory());
+                    m_free.push_back(m_objects.back().get());
+                }
+            }
+            InterpreterPool(const InterpreterPool& other) = delete;
+            InterpreterPool& operator=(const InterpreterPool& other) = delete;
+            ~InterpreterPool() = default;
+
+            /*
+            Wait for a free interpreter
+            */
+            Lease acquire() {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_available.wait(lock, [this]() {return !m_free.empty();});
+
+                T* object = m_free.back();
+                m_free.pop_back();
+                return Lease(this, object);
+            }
+
+            int size() const {
+                return m_objects.size();
+            }
+
+
+        private:
+            void release(T* object) {
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_free.push_back(object);
+                }
+                m_available.notify_one();
+            }
+
+
+        private:
+            std::vector<std::unique_ptr<T>> m_objects;
+            std::vector<T*> m_free;
+
+            std::mutex m_mutex;
+            std::condition_variable m_available;
+    };
+}
+
+#endif // INTERPRETERPOOL_H
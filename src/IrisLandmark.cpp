@@ -1,6 +1,7 @@
 #include "IrisLandmark.hpp"
+#include "LandmarkTransform.hpp"
+#include "Metrics.hpp"
 #include <iostream>
-#include <thread>
 
 #define EYE_LANDMARKS 71
 #define IRIS_LANDMARKS 5
@@ -28,36 +29,73 @@ bool __isIrisIndexValid(int idx) {
 }
 
 
-my::IrisLandmark::IrisLandmark(std::string modelPath):
-    FaceLandmark(modelPath),
-    m_leftIrisLandmarker(modelPath + std::string("/iris_landmark.tflite")),
-    m_rightIrisLandmarker(modelPath + std::string("/iris_landmark.tflite"))
-    {}
+my::IrisLandmark::IrisLandmark(std::string modelPath, bool batchEyes, const PipelineOptions& options):
+    FaceLandmark(modelPath, options),
+    m_leftIrisLandmarker(modelPath + std::string("/iris_landmark.tflite"), options.iris),
+    m_batchEyes(batchEyes),
+    m_threadPool(&ThreadPool::getDefault()),
+    m_eyeRoiSource(EyeRoiSource::FaceMesh),
+    m_hasPreviousEyeRois(false),
+    m_eyesDone(false),
+    m_irisInterval(1),
+    m_framesSinceIris(0),
+    m_hasEyeOutputs(false)
+{
+    if (m_batchEyes) {
+        auto shape = m_leftIrisLandmarker.getInputShape();
+        shape[0] = 2;
+        m_leftIrisLandmarker.resizeInput(shape);
+    }
+    else {
+        m_rightIrisLandmarker.reset(new ModelLoader(modelPath + std::string("/iris_landmark.tflite"), options.iris));
+    }
+}
 
 
 void my::IrisLandmark::runInference() {
+    m_eyesDone = false;
     FaceLandmark::runInference();
     auto roi = FaceDetection::getFaceRoi();
-    if (roi.empty()) return;
+    if (roi.empty()) {
+        m_hasPreviousEyeRois = false;
+        m_hasEyeOutputs = false;
+        return;
+    }
+
+    if (!isIrisDue()) {
+        m_framesSinceIris++;
+    }
+    else {
+        if (!m_eyesDone) {
+            Stopwatch irisTime;
+            m_leftEyeRoi = calculateEyeRoiFromMesh(true);
+            m_rightEyeRoi = calculateEyeRoiFromMesh(false);
+
+            if (m_batchEyes) {
+                runBatchedEyeInference();
+            }
+            else {
+                auto eyeTask = [this](int i) {this->runEyeInference(i != 0);};
+                m_threadPool->parallelFor(2, eyeTask);
+            }
+            FaceLandmark::setIrisTime(irisTime.getElapsedMs());
+        }
+        m_framesSinceIris = 0;
+        m_hasEyeOutputs = true;
+    }
 
-    std::thread t([this]() {this->runEyeInference(true);});
-    runEyeInference(false);
-    t.join();
+    if (m_eyeRoiSource != EyeRoiSource::FaceMesh) {
+        m_previousLeftEyeRoi = calculateEyeRoiFromMesh(true);
+        m_previousRightEyeRoi = calculateEyeRoiFromMesh(false);
+        m_hasPreviousEyeRois = true;
+    }
 }
 
 
 cv::Point my::IrisLandmark::getEyeLandmarkAt(int index, bool isLeftEye, bool isIris) const {
     if (__isEyeIndexValid(index)) {
-        auto model = isLeftEye ? &m_leftIrisLandmarker: &m_rightIrisLandmarker;
-        auto eyeRoi = isLeftEye ? m_leftEyeRoi: m_rightEyeRoi;
-
-        float _x = model->getOutputData(isIris)[index * 3];
-        float _y = model->getOutputData(isIris)[index * 3 + 1];
-
-        int x = (int)(_x / model->getInputShape()[2] * eyeRoi.width) + eyeRoi.x;
-        int y = (int)(_y / model->getInputShape()[1] * eyeRoi.height) + eyeRoi.y;
-
-        return cv::Point(x,y);
+        auto output = getOutputView(isIris, isLeftEye);
+        return toEyeImagePoint(output[index * 3], output[index * 3 + 1], isLeftEye);
     }
     return cv::Point();
 }
@@ -68,18 +106,41 @@ std::vector<cv::Point> my::IrisLandmark::getAllEyeLandmarks(bool isLeftEye, bool
         return std::vector<cv::Point>();
 
     int n = isIris ? IRIS_LANDMARKS : EYE_LANDMARKS;
+    auto output = getOutputView(isIris, isLeftEye);
 
     std::vector<cv::Point> landmarks(n);
     for (int i = 0; i < n; ++i) {
-        landmarks[i] = getEyeLandmarkAt(i, isLeftEye, isIris);
+        landmarks[i] = toEyeImagePoint(output[i * 3], output[i * 3 + 1], isLeftEye);
     }
     return landmarks;
 }
 
 
+int my::IrisLandmark::getAllEyeLandmarks(bool isLeftEye, bool isIris, float* out) const {
+    if (my::FaceDetection::getFaceRoi().empty())
+        return 0;
+
+    int n = isIris ? IRIS_LANDMARKS : EYE_LANDMARKS;
+    auto output = getOutputView(isIris, isLeftEye);
+    auto inputSize = getEyeModel(isLeftEye)->getInputImageSize();
+
+    /*
+    The left eye is mirrored in batched mode
+    */
+    transformLandmarks(output.data, n, inputSize, getEyeRoi(isLeftEye), out, m_batchEyes && isLeftEye);
+    return n;
+}
+
+
 std::vector<float> my::IrisLandmark::loadOutput(int index, bool isLeftEye) const {
-    auto model = isLeftEye ? &m_leftIrisLandmarker: &m_rightIrisLandmarker;
-    return model->loadOutput();
+    auto output = getOutputView(index, isLeftEye);
+    return std::vector<float>(output.begin(), output.end());
+}
+
+
+my::TensorView<float> my::IrisLandmark::getOutputView(int index, bool isLeftEye) const {
+    auto model = getEyeModel(isLeftEye);
+    return model->getOutputView(index != 0).slice(getEyeBatch(isLeftEye));
 }
 
 
@@ -87,6 +148,75 @@ cv::Rect my::IrisLandmark::getEyeRoi(bool isLeftEye) const {
     return isLeftEye ? m_leftEyeRoi: m_rightEyeRoi;
 }
 
+
+void my::IrisLandmark::setThreadPool(ThreadPool* pool) {
+    m_threadPool = pool;
+}
+
+
+void my::IrisLandmark::setEyeRoiSource(EyeRoiSource source) {
+    m_eyeRoiSource = source;
+    m_hasPreviousEyeRois = false;
+}
+
+
+my::EyeRoiSource my::IrisLandmark::getEyeRoiSource() const {
+    return m_eyeRoiSource;
+}
+
+
+void my::IrisLandmark::setIrisInterval(int interval) {
+    m_irisInterval = std::max(interval, 1);
+}
+
+
+int my::IrisLandmark::getIrisInterval() const {
+    return m_irisInterval;
+}
+
+
+void my::IrisLandmark::setNumThreads(int numThreads) {
+    FaceLandmark::setNumThreads(numThreads);
+    m_leftIrisLandmarker.setNumThreads(numThreads);
+    if (m_rightIrisLandmarker)
+        m_rightIrisLandmarker->setNumThreads(numThreads);
+}
+
+
+void my::IrisLandmark::setPixelFormat(PixelFormat format) {
+    FaceLandmark::setPixelFormat(format);
+    m_leftIrisLandmarker.setPixelFormat(format);
+    if (m_rightIrisLandmarker)
+        m_rightIrisLandmarker->setPixelFormat(format);
+}
+
+//-------------------Protected methods start here-------------------
+
+void my::IrisLandmark::runLandmarkInference() {
+    m_eyesDone = false;
+    bool hasFace = !FaceDetection::getFaceRoi().empty();
+
+    if (m_eyeRoiSource == EyeRoiSource::FaceMesh || !hasFace || !isIrisDue() ||
+        !getEyeRoisBeforeMesh(m_leftEyeRoi, m_rightEyeRoi)) {
+        FaceLandmark::runLandmarkInference();
+        return;
+    }
+
+    /*
+    The mesh and the eyes only share the frame (read-only), each task has its own interpreter
+    */
+    auto task = [this](int i) {
+        if (i == 0) 
+            this->FaceLandmark::runLandmarkInference();
+        else if (m_batchEyes) 
+            this->runBatchedEyeInference();
+        else 
+            this->runEyeInference(i == 1);
+    };
+    m_threadPool->parallelFor(m_batchEyes ? 2 : 3, task);
+    m_eyesDone = true;
+}
+
 //-------------------Private methods start here-------------------
 
 cv::Rect my::IrisLandmark::calculateEyeRoi(cv::Point leftMoft, cv::Point rightMost) const{
@@ -101,19 +231,83 @@ cv::Rect my::IrisLandmark::calculateEyeRoi(cv::Point leftMoft, cv::Point rightMo
 }
 
 
-void my::IrisLandmark::runEyeInference(bool isLeftEye) {
+cv::Rect my::IrisLandmark::calculateEyeRoiFromMesh(bool isLeftEye) const {
     int idx1 = isLeftEye ? 446 : 244;
     int idx2 = isLeftEye ? 464 : 226;
 
-    auto roi = isLeftEye ? &m_leftEyeRoi: &m_rightEyeRoi;
-    auto model = isLeftEye ? &m_leftIrisLandmarker: &m_rightIrisLandmarker;
-
     auto pt1 = FaceLandmark::getFaceLandmarkAt(idx1);
     auto pt2 = FaceLandmark::getFaceLandmarkAt(idx2);
 
-    *roi = calculateEyeRoi(pt1, pt2);
-    auto eyePatch = FaceDetection::cropFrame(*roi);
+    return calculateEyeRoi(pt1, pt2);
+}
+
+
+bool my::IrisLandmark::getEyeRoisBeforeMesh(cv::Rect& leftEyeRoi, cv::Rect& rightEyeRoi) const {
+    const auto& detections = FaceDetection::getDetections();
+    bool preferDetection = m_eyeRoiSource == EyeRoiSource::Detection;
+
+    if (m_hasPreviousEyeRois && (!preferDetection || detections.empty())) {
+        leftEyeRoi = m_previousLeftEyeRoi;
+        rightEyeRoi = m_previousRightEyeRoi;
+        return true;
+    }
+
+    /*
+    The first detection is the one of the face Roi
+    */
+    if (!detections.empty()) {
+        auto imageSize = FaceDetection::getOriginalImageSize();
+        leftEyeRoi = calculateEyeRoiFromDetection(detections[0], imageSize, true);
+        rightEyeRoi = calculateEyeRoiFromDetection(detections[0], imageSize, false);
+        return true;
+    }
+    return false;
+}
+
 
-    model->loadImageToInput(eyePatch);
+bool my::IrisLandmark::isIrisDue() const {
+    return !m_hasEyeOutputs || m_framesSinceIris + 1 >= m_irisInterval;
+}
+
+
+void my::IrisLandmark::runEyeInference(bool isLeftEye) {
+    auto model = isLeftEye ? &m_leftIrisLandmarker: m_rightIrisLandmarker.get();
+    model->loadRoiToInput(FaceDetection::getOriginalImage(), getEyeRoi(isLeftEye));
     model->runInference();
+}
+
+
+void my::IrisLandmark::runBatchedEyeInference() {
+    auto frame = FaceDetection::getOriginalImage();
+
+    m_leftIrisLandmarker.loadRoiToBatch(frame, m_leftEyeRoi, getEyeBatch(true), true);
+    m_leftIrisLandmarker.loadRoiToBatch(frame, m_rightEyeRoi, getEyeBatch(false), false);
+    m_leftIrisLandmarker.runInference();
+}
+
+
+const my::ModelLoader* my::IrisLandmark::getEyeModel(bool isLeftEye) const {
+    if (m_batchEyes || isLeftEye)
+        return &m_leftIrisLandmarker;
+    return m_rightIrisLandmarker.get();
+}
+
+
+cv::Point my::IrisLandmark::toEyeImagePoint(float x, float y, bool isLeftEye) const {
+    auto inputSize = getEyeModel(isLeftEye)->getInputImageSize();
+    auto eyeRoi = getEyeRoi(isLeftEye);
+
+    /*
+    Undo the mirror of the left eye in batched mode
+    */
+    if (m_batchEyes && isLeftEye) 
+        x = inputSize.width - x;
+
+    return cv::Point((int)(x / inputSize.width * eyeRoi.width) + eyeRoi.x,
+                     (int)(y / inputSize.height * eyeRoi.height) + eyeRoi.y);
+}
+
+
+int my::IrisLandmark::getEyeBatch(bool isLeftEye) const {
+    return (m_batchEyes && !isLeftEye) ? 1 : 0;
 }
\ No newline at end of file
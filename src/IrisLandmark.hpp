@@ -2,6 +2,7 @@
 #define IRISLANDMARK_H
 
 #include "FaceLandmark.hpp"
+#include "ThreadPool.hpp"
 #include <bitset>
 
 namespace my {
@@ -25,8 +26,11 @@ namespace my {
             /*
             Users MUST provide the FOLDER contain ALL the face_detection_short.tflite, 
             face_landmark.tflite and iris_landmark.tflite 
+            batchEyes: run both eyes in ONE batch-2 invocation of a single interpreter
+            (the left eye is mirrored, as Mediapipe does) instead of two interpreters in parallel
+            options: interpreter settings of each stage
             */
-            IrisLandmark(std::string modelPath);
+            IrisLandmark(std::string modelPath, bool batchEyes = false, const PipelineOptions& options = PipelineOptions());
             virtual ~IrisLandmark() = default; 
 
             /*
@@ -48,18 +52,71 @@ namespace my {
             */
             virtual std::vector<cv::Point> getAllEyeLandmarks(bool isLeftEye, bool isIris) const;
 
+            /*
+            Write all eye/iris landmarks to out in one pass: x, y (sub-pixel, relative to the input image 
+            at InputTensor(0)) and z (same scale as x) of each landmark. 
+            out must hold 5 * 3 (iris) or 71 * 3 (eye) floats.
+            Return the number of landmarks written (0 without face).
+            */
+            int getAllEyeLandmarks(bool isLeftEye, bool isIris, float* out) const;
+
             /*
             Get all landmarks from output (index = 0: Eye landmarks, index != 0: Iris landmarks)
             Each landmark is represented by x, y, z(depth), which are raw outputs from Mediapipe Iris Landmark model.
             If you want to get relative position to input image, use getAllIrisLandmarks() or getAllIrisLandmark()
+            (Note: in batched mode, the raw output of the left eye is mirrored)
             */
             virtual std::vector<float> loadOutput(int index = 0, bool isLeftEye = true) const;
 
+            /*
+            Same as loadOutput() but without copy (the batch dimension is removed).
+            */
+            virtual TensorView<float> getOutputView(int index = 0, bool isLeftEye = true) const;
+
             /*
             Get eye Roi relative to input image at InputTensor(0)
             */
             cv::Rect getEyeRoi(bool isLeftEye) const;
 
+            /*
+            Set the worker pool running both eyes in parallel 
+            (default: ThreadPool::getDefault()). The pool must outlive this object.
+            */
+            void setThreadPool(ThreadPool* pool);
+
+            /*
+            Choose where the eye Rois come from (default EyeRoiSource::FaceMesh).
+            With Detection or PreviousFrame, the iris models run at the same time as the face mesh,
+            so a frame takes about max(mesh, iris) instead of their sum.
+            */
+            void setEyeRoiSource(EyeRoiSource source);
+            EyeRoiSource getEyeRoiSource() const;
+
+            /*
+            Run the iris models every interval frames with a face (default 1: every frame).
+            In between, the eye/iris landmarks and eye Rois of their last run are kept.
+            */
+            void setIrisInterval(int interval);
+            int getIrisInterval() const;
+
+            /*
+            Override function from FaceLandmark: also change the threads of the iris models
+            */
+            virtual void setNumThreads(int numThreads);
+
+            /*
+            Override function from FaceLandmark: the iris models also read frames of format
+            */
+            virtual void setPixelFormat(PixelFormat format);
+
+
+        protected:
+            /*
+            Override function from FaceLandmark: 
+            run the eyes with the mesh when their Rois are known before it
+            */
+            virtual void runLandmarkInference();
+
 
         private:
             /*
@@ -68,17 +125,73 @@ namespace my {
             cv::Rect calculateEyeRoi(cv::Point leftMoft, cv::Point rightMost) const;
 
             /*
-            Run inference on each eye (for multithread)
+            Calculate the eye Roi from the face landmarks
+            */
+            cv::Rect calculateEyeRoiFromMesh(bool isLeftEye) const;
+
+            /*
+            Eye Rois known before the face mesh of the frame runs (see EyeRoiSource).
+            Return false if there are none.
+            */
+            bool getEyeRoisBeforeMesh(cv::Rect& leftEyeRoi, cv::Rect& rightEyeRoi) const;
+
+            /*
+            Check if the iris models run on the current frame (see setIrisInterval)
+            */
+            bool isIrisDue() const;
+
+            /*
+            Run inference on each eye at its current Roi (for multithread)
             */
             void runEyeInference(bool isLeftEye);
 
+            /*
+            Run inference on both eyes in one batch
+            */
+            void runBatchedEyeInference();
+
+            /*
+            Model and batch position holding the output of each eye
+            */
+            const ModelLoader* getEyeModel(bool isLeftEye) const;
+            int getEyeBatch(bool isLeftEye) const;
+
+            /*
+            Convert a raw eye/iris landmark to a position relative to the input image
+            */
+            cv::Point toEyeImagePoint(float x, float y, bool isLeftEye) const;
+
 
         private:
+            /*
+            In batched mode, m_leftIrisLandmarker holds both eyes 
+            and m_rightIrisLandmarker is not loaded
+            */
             ModelLoader m_leftIrisLandmarker;
-            ModelLoader m_rightIrisLandmarker;
+            std::unique_ptr<ModelLoader> m_rightIrisLandmarker;
+            bool m_batchEyes;
 
             cv::Rect m_leftEyeRoi;
             cv::Rect m_rightEyeRoi;
+
+            ThreadPool* m_threadPool;
+
+            /*
+            Eye Rois before the mesh: eye Rois of the previous frame mesh, 
+            and whether the eyes already ran with the mesh of the current frame
+            */
+            EyeRoiSource m_eyeRoiSource;
+            bool m_hasPreviousEyeRois;
+            cv::Rect m_previousLeftEyeRoi;
+            cv::Rect m_previousRightEyeRoi;
+            bool m_eyesDone;
+
+            /*
+            Iris update rate: frames since the iris models last ran, and whether their outputs are usable
+            */
+            int m_irisInterval;
+            int m_framesSinceIris;
+            bool m_hasEyeOutputs;
     };
 }
 #endif // IRISLANDMARK_H
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "KeyframeLandmark.hpp"
+#include "opencv2/video.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#define FACE_LANDMARKS  468
+#define EYE_LANDMARKS   71
+#define IRIS_LANDMARKS  5
+
+/*
+Face mesh points on textured, mostly rigid parts of the face (eye corners, nose, nostrils,
+mouth corners, brows, cheeks, chin and forehead)
+*/
+const int FACE_ANCHORS[] = {
+    33, 133, 362, 263, 1, 4, 5, 195, 197, 98, 327, 61, 291,
+    70, 105, 334, 300, 50, 280, 152, 10, 151
+};
+#define NUM_FACE_ANCHORS ((int)(sizeof(FACE_ANCHORS) / sizeof(FACE_ANCHORS[0])))
+
+/*
+Helper functions
+*/
+void copyLandmarkPoints(const float* xyz, int count, std::vector<cv::Point2f>& points) {
+    points.resize(count);
+    for (int i = 0; i < count; ++i) {
+        points[i] = cv::Point2f(xyz[i * 3], xyz[i * 3 + 1]);
+    }
+}
+
+
+void toIntegerPoints(const std::vector<cv::Point2f>& points, std::vector<cv::Point>& result) {
+    result.resize(points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        result[i] = cv::Point((int)points[i].x, (int)points[i].y);
+    }
+}
+
+
+/*
+Least-squares similarity (rotation, uniform scale, translation) mapping from[i] to to[i] for valid[i]
+*/
+bool fitSimilarity(const std::vector<cv::Point2f>& from, const std::vector<cv::Point2f>& to,
+                   const std::vector<uchar>& valid, int count, cv::Matx23f& transform) {
+    cv::Point2f meanFrom, meanTo;
+    int n = 0;
+    for (int i = 0; i < count; ++i) {
+        if (!valid[i]) continue;
+        meanFrom += from[i];
+        meanTo += to[i];
+        n++;
+    }
+    if (n < 2) return false;
+    meanFrom *= 1.f / n;
+    meanTo *= 1.f / n;
+
+    float dot = 0.f, cross = 0.f, norm = 0.f;
+    for (int i = 0; i < count; ++i) {
+        if (!valid[i]) continue;
+        auto p = from[i] - meanFrom;
+        auto q = to[i] - meanTo;
+        dot += p.x * q.x + p.y * q.y;
+        cross += p.x * q.y - p.y * q.x;
+        norm += p.x * p.x + p.y * p.y;
+    }
+    if (norm <= 0.f) return false;
+
+    float a = dot / norm;
+    float b = cross / norm;
+    transform = cv::Matx23f(a, -b, meanTo.x - (a * meanFrom.x - b * meanFrom.y),
+                            b,  a, meanTo.y - (b * meanFrom.x + a * meanFrom.y));
+    return true;
+}
+
+
+cv::Point2f transformPoint(const cv::Matx23f& m, const cv::Point2f& p) {
+    return cv::Point2f(m(0, 0) * p.x + m(0, 1) * p.y + m(0, 2), m(1, 0) * p.x + m(1, 1) * p.y + m(1, 2));
+}
+
+
+void transformPoints(const cv::Matx23f& m, std::vector<cv::Point2f>& points, cv::Point2f shift = cv::Point2f()) {
+    for (auto& point: points) {
+        point = transformPoint(m, point) + shift;
+    }
+}
+
+
+/*
+Bounding box of the transformed corners of rect
+*/
+cv::Rect2f transformRect(const cv::Matx23f& m, const cv::Rect2f& rect) {
+    cv::Point2f corners[4] = {rect.tl(), cv::Point2f(rect.br().x, rect.y), rect.br(), cv::Point2f(rect.x, rect.br().y)};
+    cv::Point2f minPoint = transformPoint(m, corners[0]), maxPoint = minPoint;
+    for (int i = 1; i < 4; ++i) {
+        auto p = transformPoint(m, corners[i]);
+        minPoint.x = std::min(minPoint.x, p.x); maxPoint.x = std::max(maxPoint.x, p.x);
+        minPoint.y = std::min(minPoint.y, p.y); maxPoint.y = std::max(maxPoint.y, p.y);
+    }
+    return cv::Rect2f(minPoint, maxPoint);
+}
+
+
+my::KeyframeLandmark::KeyframeLandmark(std::string modelPath, const KeyframeOptions& options,
+                                       const PipelineOptions& pipelineOptions):
+    m_pipeline(modelPath, false, pipelineOptions),
+    m_options(options),
+    m_keyframeRequested(true),
+    m_isKeyframe(false),
+    m_hasFace(false),
+    m_framesSinceKeyframe(0),
+    m_buffer(FACE_LANDMARKS * 3)
+{
+    m_options.maxInterval = std::max(m_options.maxInterval, 1);
+}
+
+
+void my::KeyframeLandmark::process(const cv::Mat& frame) {
+    buildPyramid(frame, m_pyramid);
+
+    bool sizeChanged = m_previousPyramid.empty() || m_previousPyramid[0].size() != m_pyramid[0].size();
+    bool needKeyframe = m_keyframeRequested || !m_hasFace || sizeChanged ||
+        m_framesSinceKeyframe + 1 >= m_options.maxInterval;
+
+    if (!needKeyframe && propagate()) {
+        m_isKeyframe = false;
+        m_framesSinceKeyframe++;
+    }
+    else {
+        runKeyframe(frame);
+    }
+
+    /*
+    The pyramid of this frame is the previous one of the next frame, buffers are swapped, not copied
+    */
+    std::swap(m_previousPyramid, m_pyramid);
+}
+
+
+void my::KeyframeLandmark::requestKeyframe() {
+    m_keyframeRequested = true;
+}
+
+
+bool my::KeyframeLandmark::isKeyframe() const {
+    return m_isKeyframe;
+}
+
+
+bool my::KeyframeLandmark::hasFace() const {
+    return m_hasFace;
+}
+
+
+int my::KeyframeLandmark::getFramesSinceKeyframe() const {
+    return m_framesSinceKeyframe;
+}
+
+
+const std::vector<cv::Point2f>& my::KeyframeLandmark::getFaceLandmarks() const {
+    return m_faceLandmarks;
+}
+
+
+const std::vector<cv::Point2f>& my::KeyframeLandmark::getEyeLandmarks(bool isLeftEye, bool isIris) const {
+    int eye = isLeftEye ? 0 : 1;
+    return isIris ? m_irisLandmarks[eye] : m_eyeLandmarks[eye];
+}
+
+
+void my::KeyframeLandmark::getResult(FaceResult& result) const {
+    result.presence = m_hasFace ? m_pipeline.getFacePresence() : 0.f;
+    result.roi = cv::Rect(m_roi);
+    result.leftEyeRoi = cv::Rect(m_eyeRois[0]);
+    result.rightEyeRoi = cv::Rect(m_eyeRois[1]);
+
+    toIntegerPoints(m_faceLandmarks, result.faceLandmarks);
+    toIntegerPoints(m_eyeLandmarks[0], result.leftEyeLandmarks);
+    toIntegerPoints(m_eyeLandmarks[1], result.rightEyeLandmarks);
+    toIntegerPoints(m_irisLandmarks[0], result.leftIrisLandmarks);
+    toIntegerPoints(m_irisLandmarks[1], result.rightIrisLandmarks);
+}
+
+
+my::IrisLandmark& my::KeyframeLandmark::getPipeline() {
+    return m_pipeline;
+}
+
+//-------------------Private methods start here-------------------
+
+void my::KeyframeLandmark::runKeyframe(const cv::Mat& frame) {
+    m_pipeline.loadImageToInput(frame);
+    m_pipeline.runInference();
+
+    m_isKeyframe = true;
+    m_keyframeRequested = false;
+    m_framesSinceKeyframe = 0;
+    m_hasFace = m_pipeline.getAllFaceLandmarks(m_buffer.data()) > 0;
+
+    if (!m_hasFace) {
+        m_faceLandmarks.clear();
+        for (int eye = 0; eye < 2; ++eye) {
+            m_eyeLandmarks[eye].clear();
+            m_irisLandmarks[eye].clear();
+            m_eyeRois[eye] = cv::Rect2f();
+        }
+        m_roi = cv::Rect2f();
+        return;
+    }
+
+    copyLandmarkPoints(m_buffer.data(), FACE_LANDMARKS, m_faceLandmarks);
+    m_roi = cv::Rect2f(m_pipeline.getFaceRoi());
+
+    for (int eye = 0; eye < 2; ++eye) {
+        bool isLeftEye = eye == 0;
+        m_pipeline.getAllEyeLandmarks(isLeftEye, false, m_buffer.data());
+        copyLandmarkPoints(m_buffer.data(), EYE_LANDMARKS, m_eyeLandmarks[eye]);
+        m_pipeline.getAllEyeLandmarks(isLeftEye, true, m_buffer.data());
+        copyLandmarkPoints(m_buffer.data(), IRIS_LANDMARKS, m_irisLandmarks[eye]);
+        m_eyeRois[eye] = cv::Rect2f(m_pipeline.getEyeRoi(isLeftEye));
+    }
+}
+
+
+bool my::KeyframeLandmark::propagate() {
+    /*
+    Face anchors, then the iris center (first iris landmark) of each eye
+    */
+    m_anchors.resize(NUM_FACE_ANCHORS + 2);
+    for (int i = 0; i < NUM_FACE_ANCHORS; ++i) {
+        m_anchors[i] = m_faceLandmarks[FACE_ANCHORS[i]];
+    }
+    m_anchors[NUM_FACE_ANCHORS] = m_irisLandmarks[0][0];
+    m_anchors[NUM_FACE_ANCHORS + 1] = m_irisLandmarks[1][0];
+
+    cv::Size window(m_options.windowSize, m_options.windowSize);
+    cv::calcOpticalFlowPyrLK(m_previousPyramid, m_pyramid, m_anchors, m_trackedAnchors,
+        m_status, m_flowErrors, window, m_options.pyramidLevels);
+    cv::calcOpticalFlowPyrLK(m_pyramid, m_previousPyramid, m_trackedAnchors, m_backtrackedAnchors,
+        m_backStatus, m_flowErrors, window, m_options.pyramidLevels);
+
+    /*
+    A point is kept if it tracks back to where it started
+    */
+    m_errors.clear();
+    int tracked = 0;
+    for (int i = 0; i < (int)m_anchors.size(); ++i) {
+        auto difference = m_backtrackedAnchors[i] - m_anchors[i];
+        float error = std::sqrt(difference.x * difference.x + difference.y * difference.y);
+        bool isFound = m_status[i] && m_backStatus[i];
+
+        if (isFound && i < NUM_FACE_ANCHORS) m_errors.push_back(error);
+        m_status[i] = isFound && error <= m_options.maxFlowError;
+        if (m_status[i] && i < NUM_FACE_ANCHORS) tracked++;
+    }
+
+    if (tracked < m_options.minTrackedRatio * NUM_FACE_ANCHORS || m_errors.empty())
+        return false;
+
+    auto median = m_errors.begin() + m_errors.size() / 2;
+    std::nth_element(m_errors.begin(), median, m_errors.end());
+    if (*median > m_options.maxFlowError)
+        return false;
+
+    cv::Matx23f transform;
+    if (!fitSimilarity(m_anchors, m_trackedAnchors, m_status, NUM_FACE_ANCHORS, transform))
+        return false;
+
+    /*
+    The face moves rigidly, each iris also follows its own center (gaze)
+    */
+    transformPoints(transform, m_faceLandmarks);
+    m_roi = transformRect(transform, m_roi);
+
+    for (int eye = 0; eye < 2; ++eye) {
+        int anchor = NUM_FACE_ANCHORS + eye;
+        cv::Point2f gaze;
+        if (m_status[anchor])
+            gaze = m_trackedAnchors[anchor] - transformPoint(transform, m_anchors[anchor]);
+
+        transformPoints(transform, m_eyeLandmarks[eye]);
+        transformPoints(transform, m_irisLandmarks[eye], gaze);
+        m_eyeRois[eye] = transformRect(transform, m_eyeRois[eye]);
+    }
+    return true;
+}
+
+
+void my::KeyframeLandmark::buildPyramid(const cv::Mat& frame, std::vector<cv::Mat>& pyramid) {
+    convertToGray(frame, m_pipeline.getPixelFormat(), m_gray);
+
+    /*
+    The gray image is overwritten by the next frame: the pyramid must not share it
+    */
+    cv::Size window(m_options.windowSize, m_options.windowSize);
+    cv::buildOpticalFlowPyramid(m_gray, pyramid, window, m_options.pyramidLevels, true,
+        cv::BORDER_REFLECT_101, cv::BORDER_CONSTANT, false);
+}
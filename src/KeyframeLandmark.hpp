@@ -0,0 +1,141 @@
+#ifndef KEYFRAMELANDMARK_H
+#define KEYFRAMELANDMARK_H
+
+#include "IrisLandmark.hpp"
+#include "FaceMeshWorker.hpp"
+
+namespace my {
+
+    /*
+    Settings of KeyframeLandmark.
+    Attributes:
+        maxInterval: frames between two keyframes at most (1: every frame is a keyframe)
+        maxFlowError: forward-backward error (pixels) above which a tracked point is rejected,
+                      and above which the median error of the face anchors triggers a keyframe
+        minTrackedRatio: keyframe when fewer face anchors than this ratio are tracked
+        windowSize, pyramidLevels: Lucas-Kanade window (pixels) and number of pyramid levels
+    */
+    struct KeyframeOptions {
+        int maxInterval = 10;
+        float maxFlowError = 1.5f;
+        float minTrackedRatio = 0.6f;
+        int windowSize = 21;
+        int pyramidLevels = 3;
+    };
+
+    /*
+    Run the full IrisLandmark pipeline on keyframes only, and carry the landmarks forward in between
+    with sparse optical flow: a few textured face mesh points and both iris centers are tracked
+    (pyramidal Lucas-Kanade, checked forward and backward), the face mesh and eye contours follow
+    the similarity transform of the face anchors and each iris also follows its own center.
+    A keyframe runs when the flow error grows, too few anchors are tracked, the frame size changes
+    or maxInterval frames have passed.
+    Positions are sub-pixel, relative to the frames given to process().
+    This class is non-copyable and expects consecutive frames of ONE video.
+    */
+    class KeyframeLandmark {
+        public:
+            /*
+            Users MUST provide the FOLDER contain ALL the face_detection_short.tflite,
+            face_landmark.tflite and iris_landmark.tflite
+            */
+            KeyframeLandmark(std::string modelPath, const KeyframeOptions& options = KeyframeOptions(),
+                             const PipelineOptions& pipelineOptions = PipelineOptions());
+            KeyframeLandmark(const KeyframeLandmark& other) = delete;
+            KeyframeLandmark& operator=(const KeyframeLandmark& other) = delete;
+            ~KeyframeLandmark() = default;
+
+            /*
+            Process the next frame (BGR format, CV_8UC3 or CV_8UC4, or the pixel format of getPipeline())
+            */
+            void process(const cv::Mat& frame);
+
+            /*
+            Run the full pipeline on the next frame, whatever the flow error
+            */
+            void requestKeyframe();
+
+            /*
+            Check if the last frame was a keyframe / had a face
+            */
+            bool isKeyframe() const;
+            bool hasFace() const;
+
+            /*
+            Frames processed since the last keyframe (0 on a keyframe)
+            */
+            int getFramesSinceKeyframe() const;
+
+            /*
+            Landmarks of the last frame (empty without face): 468 face points,
+            71 eye / 5 iris points of each eye
+            */
+            const std::vector<cv::Point2f>& getFaceLandmarks() const;
+            const std::vector<cv::Point2f>& getEyeLandmarks(bool isLeftEye, bool isIris) const;
+
+            /*
+            Landmarks and Rois of the last frame as integer positions, as the other pipelines report them.
+            The vectors of result are reused.
+            */
+            void getResult(FaceResult& result) const;
+
+            /*
+            The pipeline run on keyframes (e.g. to set its thread pool or eye Roi source)
+            */
+            IrisLandmark& getPipeline();
+
+
+        private:
+            /*
+            Run the pipeline on frame and save its landmarks
+            */
+            void runKeyframe(const cv::Mat& frame);
+
+            /*
+            Track the anchors from the previous frame, move every landmark.
+            Return false if the flow is not reliable enough.
+            */
+            bool propagate();
+
+            /*
+            Gray image and its pyramid for the optical flow
+            */
+            void buildPyramid(const cv::Mat& frame, std::vector<cv::Mat>& pyramid);
+
+
+        private:
+            IrisLandmark m_pipeline;
+            KeyframeOptions m_options;
+
+            bool m_keyframeRequested;
+            bool m_isKeyframe;
+            bool m_hasFace;
+            int m_framesSinceKeyframe;
+
+            /*
+            Landmarks, eyes are indexed by isLeftEye ? 0 : 1
+            */
+            std::vector<cv::Point2f> m_faceLandmarks;
+            std::vector<cv::Point2f> m_eyeLandmarks[2];
+            std::vector<cv::Point2f> m_irisLandmarks[2];
+            cv::Rect2f m_roi;
+            cv::Rect2f m_eyeRois[2];
+
+            /*
+            Optical flow buffers, reused from frame to frame
+            */
+            cv::Mat m_gray;
+            std::vector<cv::Mat> m_previousPyramid;
+            std::vector<cv::Mat> m_pyramid;
+            std::vector<cv::Point2f> m_anchors;
+            std::vector<cv::Point2f> m_trackedAnchors;
+            std::vector<cv::Point2f> m_backtrackedAnchors;
+            std::vector<uchar> m_status;
+            std::vector<uchar> m_backStatus;
+            std::vector<float> m_flowErrors;
+            std::vector<float> m_errors;
+            std::vector<float> m_buffer;
+    };
+}
+
+#endif // KEYFRAMELANDMARK_H
@@ -0,0 +1,505 @@
+#include "LandmarkStream.hpp"
+#include "HalfFloat.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#if defined(_WIN32)
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define FACE_LANDMARKS  468
+#define EYE_LANDMARKS   71
+#define IRIS_LANDMARKS  5
+#define NUM_COMPONENTS  (LANDMARK_POINTS_PER_FRAME * 2)
+
+/*
+Byte offsets of the arrays of a chunk payload of n frames
+*/
+struct ChunkLayout {
+    size_t timestamps;
+    size_t presence;
+    size_t flags;
+    size_t rois;
+    size_t points;
+    size_t total;
+};
+
+
+/*
+Helper functions
+*/
+size_t alignTo8(size_t bytes) {
+    return (bytes + 7) & ~(size_t)7;
+}
+
+
+ChunkLayout getChunkLayout(size_t n, bool fp16) {
+    ChunkLayout layout;
+    layout.timestamps = 0;
+    layout.presence = alignTo8(layout.timestamps + n * sizeof(int64_t));
+    layout.flags = alignTo8(layout.presence + n * sizeof(float));
+    layout.rois = alignTo8(layout.flags + n * sizeof(uint8_t));
+    layout.points = alignTo8(layout.rois + n * LANDMARK_ROIS_PER_FRAME * 4 * sizeof(int32_t));
+    layout.total = alignTo8(layout.points + n * NUM_COMPONENTS * (fp16 ? sizeof(uint16_t) : sizeof(float)));
+    return layout;
+}
+
+
+/*
+Copy points into dst (x, y interleaved), return false (and write zeros) if count does not match
+*/
+bool copyPoints(const std::vector<cv::Point>& points, size_t count, float* dst) {
+    bool isValid = points.size() == count;
+    for (size_t i = 0; i < count; ++i) {
+        dst[2 * i] = isValid ? (float)points[i].x : 0.f;
+        dst[2 * i + 1] = isValid ? (float)points[i].y : 0.f;
+    }
+    return isValid;
+}
+
+
+void copyRoi(const cv::Rect& roi, int32_t* dst) {
+    dst[0] = roi.x;
+    dst[1] = roi.y;
+    dst[2] = roi.width;
+    dst[3] = roi.height;
+}
+
+
+void readPoints(const float* points, int frame, int firstPoint, int count, int numFrames, std::vector<cv::Point>& dst) {
+    dst.resize(count);
+    for (int i = 0; i < count; ++i) {
+        int component = 2 * (firstPoint + i);
+        dst[i].x = (int)std::lround(points[(size_t)component * numFrames + frame]);
+        dst[i].y = (int)std::lround(points[(size_t)(component + 1) * numFrames + frame]);
+    }
+}
+
+
+my::LandmarkStreamWriter::LandmarkStreamWriter(const std::string& path, const LandmarkStreamOptions& options):
+    m_file(path, std::ios::binary | std::ios::trunc),
+    m_offset(0),
+    m_queue(std::max(options.queueCapacity, 1)),
+    m_closed(false)
+{
+    std::memset(&m_header, 0, sizeof(m_header));
+    std::memcpy(m_header.magic, "FMLS", 4);
+    m_header.version = LANDMARK_STREAM_VERSION;
+    m_header.flags = (options.fp16 ? LANDMARK_STREAM_FP16 : 0) | (options.deltaCoding ? LANDMARK_STREAM_DELTA : 0);
+    m_header.framesPerChunk = std::max(options.framesPerChunk, 1);
+    m_header.pointsPerFrame = LANDMARK_POINTS_PER_FRAME;
+
+    if (!m_file) {
+        std::cerr << "Cannot write " << path << std::endl;
+        m_closed = true;
+        return;
+    }
+    writeBytes(&m_header, sizeof(m_header));
+    m_chunk.reserve(m_header.framesPerChunk);
+    m_writerThread = std::thread(&LandmarkStreamWriter::runWriter, this);
+}
+
+
+my::LandmarkStreamWriter::~LandmarkStreamWriter() {
+    close();
+}
+
+
+bool my::LandmarkStreamWriter::isOpened() const {
+    return !m_closed;
+}
+
+
+void my::LandmarkStreamWriter::write(long long timestamp, const FaceResult& result) {
+    if (m_closed) return;
+
+    FrameRecord record;
+    record.timestamp = timestamp;
+    record.presence = result.presence;
+    record.flags = 0;
+
+    copyRoi(result.roi, record.rois);
+    copyRoi(result.leftEyeRoi, record.rois + 4);
+    copyRoi(result.rightEyeRoi, record.rois + 8);
+
+    float* points = record.points;
+    if (copyPoints(result.faceLandmarks, FACE_LANDMARKS, points))
+        record.flags |= LANDMARK_FRAME_FACE;
+    points += 2 * FACE_LANDMARKS;
+
+    bool leftEye = copyPoints(result.leftEyeLandmarks, EYE_LANDMARKS, points);
+    points += 2 * EYE_LANDMARKS;
+    bool leftIris = copyPoints(result.leftIrisLandmarks, IRIS_LANDMARKS, points);
+    points += 2 * IRIS_LANDMARKS;
+    if (leftEye && leftIris) record.flags |= LANDMARK_FRAME_LEFT_EYE;
+
+    bool rightEye = copyPoints(result.rightEyeLandmarks, EYE_LANDMARKS, points);
+    points += 2 * EYE_LANDMARKS;
+    bool rightIris = copyPoints(result.rightIrisLandmarks, IRIS_LANDMARKS, points);
+    if (rightEye && rightIris) record.flags |= LANDMARK_FRAME_RIGHT_EYE;
+
+    m_queue.push(record);
+}
+
+
+void my::LandmarkStreamWriter::close() {
+    if (m_closed) return;
+    m_closed = true;
+
+    m_queue.close();
+    m_writerThread.join();
+
+    /*
+    Index, then the final header
+    */
+    m_header.chunkCount = m_index.size();
+    m_header.indexOffset = m_offset;
+    if (!m_index.empty())
+        writeBytes(m_index.data(), m_index.size() * sizeof(LandmarkIndexEntry));
+
+    m_file.seekp(0);
+    m_file.write(reinterpret_cast<const char*>(&m_header), sizeof(m_header));
+    m_file.close();
+}
+
+//-------------------Private methods start here-------------------
+
+void my::LandmarkStreamWriter::runWriter() {
+    FrameRecord record;
+    while (m_queue.pop(record)) {
+        m_chunk.push_back(record);
+        if (m_chunk.size() == m_header.framesPerChunk)
+            writeChunk();
+    }
+    writeChunk();
+}
+
+
+void my::LandmarkStreamWriter::writeChunk() {
+    if (m_chunk.empty()) return;
+
+    size_t n = m_chunk.size();
+    bool fp16 = (m_header.flags & LANDMARK_STREAM_FP16) != 0;
+    bool delta = (m_header.flags & LANDMARK_STREAM_DELTA) != 0;
+    auto layout = getChunkLayout(n, fp16);
+    m_payload.assign(layout.total, 0);
+
+    auto timestamps = reinterpret_cast<int64_t*>(&m_payload[layout.timestamps]);
+    auto presence = reinterpret_cast<float*>(&m_payload[layout.presence]);
+    auto flags = &m_payload[layout.flags];
+    auto rois = reinterpret_cast<int32_t*>(&m_payload[layout.rois]);
+
+    for (size_t f = 0; f < n; ++f) {
+        timestamps[f] = m_chunk[f].timestamp;
+        presence[f] = m_chunk[f].presence;
+        flags[f] = m_chunk[f].flags;
+        for (int r = 0; r < LANDMARK_ROIS_PER_FRAME * 4; ++r) {
+            rois[r * n + f] = m_chunk[f].rois[r];
+        }
+    }
+
+    /*
+    Differences are taken to the value the reader will reconstruct (not the exact one),
+    so fp16 rounding errors do not accumulate along the chunk.
+    */
+    auto points32 = reinterpret_cast<float*>(&m_payload[layout.points]);
+    auto points16 = reinterpret_cast<uint16_t*>(&m_payload[layout.points]);
+    for (size_t c = 0; c < NUM_COMPONENTS; ++c) {
+        float reconstructed = 0.f;
+        for (size_t f = 0; f < n; ++f) {
+            bool isDelta = delta && f > 0;
+            float value = m_chunk[f].points[c];
+            float stored = isDelta ? value - reconstructed : value;
+
+            if (fp16) {
+                points16[c * n + f] = floatToHalf(stored);
+                stored = halfToFloat(points16[c * n + f]);
+            }
+            else {
+                points32[c * n + f] = stored;
+            }
+            reconstructed = isDelta ? reconstructed + stored : stored;
+        }
+    }
+
+    LandmarkChunkHeader header;
+    std::memcpy(header.magic, "CHNK", 4);
+    header.frameCount = (uint32_t)n;
+    header.firstFrame = m_header.frameCount;
+    header.payloadBytes = layout.total;
+
+    m_index.push_back({header.firstFrame, m_offset, m_chunk[0].timestamp});
+    writeBytes(&header, sizeof(header));
+    writeBytes(m_payload.data(), m_payload.size());
+
+    m_header.frameCount += n;
+    m_chunk.clear();
+}
+
+
+void my::LandmarkStreamWriter::writeBytes(const void* data, size_t bytes) {
+    m_file.write(static_cast<const char*>(data), bytes);
+    m_offset += bytes;
+}
+
+
+my::LandmarkStreamReader::LandmarkStreamReader(const std::string& path):
+    m_data(nullptr),
+    m_size(0),
+#if defined(_WIN32)
+    m_fileHandle(INVALID_HANDLE_VALUE),
+    m_mappingHandle(nullptr),
+#else
+    m_fd(-1),
+#endif
+    m_frameCount(0),
+    m_cachedChunk(-1),
+    m_chunkFrames(0),
+    m_timestamps(nullptr),
+    m_presence(nullptr),
+    m_flags(nullptr),
+    m_rois(nullptr)
+{
+    std::memset(&m_header, 0, sizeof(m_header));
+#if defined(_WIN32)
+    m_fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER fileSize;
+    if (m_fileHandle != INVALID_HANDLE_VALUE && GetFileSizeEx(m_fileHandle, &fileSize) && fileSize.QuadPart > 0) {
+        m_mappingHandle = CreateFileMappingA(m_fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_mappingHandle != nullptr) {
+            m_data = static_cast<const uint8_t*>(MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0));
+            m_size = (size_t)fileSize.QuadPart;
+        }
+    }
+#else
+    m_fd = open(path.c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (m_fd >= 0 && fstat(m_fd, &fileStat) == 0 && fileStat.st_size > 0) {
+        void* data = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+        if (data != MAP_FAILED) {
+            m_data = static_cast<const uint8_t*>(data);
+            m_size = (size_t)fileStat.st_size;
+        }
+    }
+#endif
+    if (m_data == nullptr) {
+        std::cerr << "Cannot map " << path << std::endl;
+        unmap();
+        return;
+    }
+
+    /*
+    Check the header, then load the index (or rebuild it from the chunks)
+    */
+    bool isValid = m_size >= sizeof(m_header);
+    if (isValid) {
+        std::memcpy(&m_header, m_data, sizeof(m_header));
+        isValid = std::memcmp(m_header.magic, "FMLS", 4) == 0 && m_header.version == LANDMARK_STREAM_VERSION
+            && m_header.pointsPerFrame == LANDMARK_POINTS_PER_FRAME;
+    }
+
+    bool hasIndex = isValid && m_header.indexOffset != 0 && m_header.indexOffset <= m_size &&
+        m_header.chunkCount <= (m_size - m_header.indexOffset) / sizeof(LandmarkIndexEntry);
+    size_t indexBytes = hasIndex ? m_header.chunkCount * sizeof(LandmarkIndexEntry) : 0;
+    if (hasIndex) {
+        m_index.resize(m_header.chunkCount);
+        std::memcpy(m_index.data(), m_data + m_header.indexOffset, indexBytes);
+        m_frameCount = m_header.frameCount;
+    }
+    else if (isValid) {
+        isValid = scanChunks();
+    }
+
+    if (!isValid) {
+        std::cerr << path << " is not a valid landmark file" << std::endl;
+        unmap();
+    }
+}
+
+
+my::LandmarkStreamReader::~LandmarkStreamReader() {
+    unmap();
+}
+
+
+bool my::LandmarkStreamReader::isOpened() const {
+    return m_data != nullptr;
+}
+
+
+long long my::LandmarkStreamReader::getFrameCount() const {
+    return m_frameCount;
+}
+
+
+bool my::LandmarkStreamReader::read(long long index, FaceResult& result, long long* timestamp) {
+    if (!isOpened() || index < 0 || index >= m_frameCount) return false;
+
+    auto it = std::upper_bound(m_index.begin(), m_index.end(), (uint64_t)index,
+        [](uint64_t frame, const LandmarkIndexEntry& entry) {return frame < entry.firstFrame;});
+    size_t chunk = (it - m_index.begin()) - 1;
+    if (!loadChunk(chunk)) return false;
+
+    int f = (int)(index - m_index[chunk].firstFrame);
+    if (f >= m_chunkFrames) return false;
+
+    int n = m_chunkFrames;
+    if (timestamp != nullptr) *timestamp = m_timestamps[f];
+    result.presence = m_presence[f];
+
+    cv::Rect* rois[] = {&result.roi, &result.leftEyeRoi, &result.rightEyeRoi};
+    for (int r = 0; r < LANDMARK_ROIS_PER_FRAME; ++r) {
+        const int32_t* roi = m_rois + (size_t)r * 4 * n;
+        *rois[r] = cv::Rect(roi[f], roi[n + f], roi[2 * n + f], roi[3 * n + f]);
+    }
+
+    const float* points = m_decoded.data();
+    uint8_t flags = m_flags[f];
+    int firstPoint = 0;
+
+    result.faceLandmarks.clear();
+    if (flags & LANDMARK_FRAME_FACE)
+        readPoints(points, f, firstPoint, FACE_LANDMARKS, n, result.faceLandmarks);
+    firstPoint += FACE_LANDMARKS;
+
+    result.leftEyeLandmarks.clear();
+    result.leftIrisLandmarks.clear();
+    if (flags & LANDMARK_FRAME_LEFT_EYE) {
+        readPoints(points, f, firstPoint, EYE_LANDMARKS, n, result.leftEyeLandmarks);
+        readPoints(points, f, firstPoint + EYE_LANDMARKS, IRIS_LANDMARKS, n, result.leftIrisLandmarks);
+    }
+    firstPoint += EYE_LANDMARKS + IRIS_LANDMARKS;
+
+    result.rightEyeLandmarks.clear();
+    result.rightIrisLandmarks.clear();
+    if (flags & LANDMARK_FRAME_RIGHT_EYE) {
+        readPoints(points, f, firstPoint, EYE_LANDMARKS, n, result.rightEyeLandmarks);
+        readPoints(points, f, firstPoint + EYE_LANDMARKS, IRIS_LANDMARKS, n, result.rightIrisLandmarks);
+    }
+    return true;
+}
+
+
+long long my::LandmarkStreamReader::findFrame(long long timestamp) {
+    if (!isOpened() || m_index.empty()) return -1;
+
+    /*
+    Last chunk starting at or before timestamp, then search inside it
+    */
+    auto it = std::upper_bound(m_index.begin(), m_index.end(), timestamp,
+        [](long long t, const LandmarkIndexEntry& entry) {return t < entry.firstTimestamp;});
+    if (it == m_index.begin()) return 0;
+
+    size_t chunk = (it - m_index.begin()) - 1;
+    if (!loadChunk(chunk)) return -1;
+
+    auto found = std::lower_bound(m_timestamps, m_timestamps + m_chunkFrames, (int64_t)timestamp);
+    if (found != m_timestamps + m_chunkFrames)
+        return m_index[chunk].firstFrame + (found - m_timestamps);
+
+    return chunk + 1 < m_index.size() ? (long long)m_index[chunk + 1].firstFrame : -1;
+}
+
+//-------------------Private methods start here-------------------
+
+bool my::LandmarkStreamReader::scanChunks() {
+    bool fp16 = (m_header.flags & LANDMARK_STREAM_FP16) != 0;
+    size_t offset = sizeof(m_header);
+    m_index.clear();
+    m_frameCount = 0;
+
+    while (offset + sizeof(LandmarkChunkHeader) <= m_size) {
+        LandmarkChunkHeader header;
+        std::memcpy(&header, m_data + offset, sizeof(header));
+        if (std::memcmp(header.magic, "CHNK", 4) != 0 || header.frameCount == 0) break;
+        if (header.payloadBytes != getChunkLayout(header.frameCount, fp16).total) break;
+
+        /*
+        The last chunk may be truncated if the writer stopped while writing it
+        */
+        size_t end = offset + sizeof(header) + header.payloadBytes;
+        if (end > m_size) break;
+
+        int64_t firstTimestamp;
+        std::memcpy(&firstTimestamp, m_data + offset + sizeof(header), sizeof(firstTimestamp));
+        m_index.push_back({header.firstFrame, offset, firstTimestamp});
+        m_frameCount = header.firstFrame + header.frameCount;
+        offset = end;
+    }
+    return true;
+}
+
+
+bool my::LandmarkStreamReader::loadChunk(size_t i) {
+    if (m_cachedChunk == (long long)i) return true;
+    if (i >= m_index.size()) return false;
+
+    size_t offset = m_index[i].offset;
+    LandmarkChunkHeader header;
+    if (offset + sizeof(header) > m_size) return false;
+    std::memcpy(&header, m_data + offset, sizeof(header));
+
+    bool fp16 = (m_header.flags & LANDMARK_STREAM_FP16) != 0;
+    bool delta = (m_header.flags & LANDMARK_STREAM_DELTA) != 0;
+    size_t n = header.frameCount;
+    auto layout = getChunkLayout(n, fp16);
+    if (std::memcmp(header.magic, "CHNK", 4) != 0 || header.payloadBytes != layout.total ||
+        offset + sizeof(header) + layout.total > m_size) {
+        std::cerr << "Corrupted landmark chunk " << i << std::endl;
+        return false;
+    }
+
+    /*
+    Every array is 8-byte aligned in the file, so they are used in place
+    */
+    const uint8_t* payload = m_data + offset + sizeof(header);
+    m_timestamps = reinterpret_cast<const int64_t*>(payload + layout.timestamps);
+    m_presence = reinterpret_cast<const float*>(payload + layout.presence);
+    m_flags = payload + layout.flags;
+    m_rois = reinterpret_cast<const int32_t*>(payload + layout.rois);
+
+    auto points32 = reinterpret_cast<const float*>(payload + layout.points);
+    auto points16 = reinterpret_cast<const uint16_t*>(payload + layout.points);
+    m_decoded.resize(n * NUM_COMPONENTS);
+    for (size_t c = 0; c < NUM_COMPONENTS; ++c) {
+        float reconstructed = 0.f;
+        for (size_t f = 0; f < n; ++f) {
+            float stored = fp16 ? halfToFloat(points16[c * n + f]) : points32[c * n + f];
+            reconstructed = (delta && f > 0) ? reconstructed + stored : stored;
+            m_decoded[c * n + f] = reconstructed;
+        }
+    }
+
+    m_chunkFrames = (int)n;
+    m_cachedChunk = i;
+    return true;
+}
+
+
+void my::LandmarkStreamReader::unmap() {
+#if defined(_WIN32)
+    if (m_data != nullptr) UnmapViewOfFile(m_data);
+    if (m_mappingHandle != nullptr) CloseHandle(m_mappingHandle);
+    if (m_fileHandle != INVALID_HANDLE_VALUE) CloseHandle(m_fileHandle);
+    m_mappingHandle = nullptr;
+    m_fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (m_data != nullptr) munmap(const_cast<uint8_t*>(m_data), m_size);
+    if (m_fd >= 0) ::close(m_fd);
+    m_fd = -1;
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_frameCount = 0;
+    m_index.clear();
+    m_cachedChunk = -1;
+}
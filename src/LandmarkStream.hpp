@@ -0,0 +1,210 @@
+#ifndef LANDMARKSTREAM_H
+#define LANDMARKSTREAM_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FaceMeshWorker.hpp"
+#include "BoundedQueue.hpp"
+
+#define LANDMARK_STREAM_VERSION     1
+#define LANDMARK_STREAM_FP16        0x1
+#define LANDMARK_STREAM_DELTA       0x2
+#define LANDMARK_POINTS_PER_FRAME   (468 + 2 * (71 + 5))
+#define LANDMARK_ROIS_PER_FRAME     3
+
+#define LANDMARK_FRAME_FACE         0x1
+#define LANDMARK_FRAME_LEFT_EYE     0x2
+#define LANDMARK_FRAME_RIGHT_EYE    0x4
+
+namespace my {
+
+    /*
+    Binary landmark file layout (little endian, every block is 8-byte aligned):
+        LandmarkFileHeader
+        chunks: LandmarkChunkHeader + payload of up to framesPerChunk consecutive frames
+        index: one LandmarkIndexEntry per chunk (indexOffset is 0 if the writer did not close the file)
+    A chunk payload is Structure-of-Arrays, each array holding one value per frame:
+        int64 timestamps, float presence, uint8 flags (LANDMARK_FRAME_*),
+        int32 x, y, width, height of the face, left eye and right eye Rois,
+        float (or fp16) x and y of each point: face (468), left eye (71), left iris (5), right eye (71), right iris (5).
+    With delta coding, every point value but the first of a chunk is stored as the difference to
+    the previous frame, so each chunk can be decoded on its own.
+    */
+    struct LandmarkFileHeader {
+        char magic[4];
+        uint32_t version;
+        uint32_t flags;
+        uint32_t framesPerChunk;
+        uint32_t pointsPerFrame;
+        uint32_t reserved;
+        uint64_t frameCount;
+        uint64_t chunkCount;
+        uint64_t indexOffset;
+    };
+
+    struct LandmarkChunkHeader {
+        char magic[4];
+        uint32_t frameCount;
+        uint64_t firstFrame;
+        uint64_t payloadBytes;
+    };
+
+    struct LandmarkIndexEntry {
+        uint64_t firstFrame;
+        uint64_t offset;
+        int64_t firstTimestamp;
+    };
+
+    /*
+    Settings of LandmarkStreamWriter.
+    Attributes:
+        fp16: store points as half floats (exact for integer positions up to 2048)
+        deltaCoding: store point differences between consecutive frames
+        framesPerChunk: frames per chunk (the unit of seeking and of writes)
+        queueCapacity: frames waiting for the writer thread before write() blocks
+    */
+    struct LandmarkStreamOptions {
+        bool fp16 = false;
+        bool deltaCoding = false;
+        int framesPerChunk = 256;
+        int queueCapacity = 64;
+    };
+
+    /*
+    Write FaceResults to a binary landmark file from a background thread.
+    write() only copies the landmarks, chunks are encoded and written by the writer thread.
+    This class is non-copyable.
+    */
+    class LandmarkStreamWriter {
+        public:
+            LandmarkStreamWriter(const std::string& path, const LandmarkStreamOptions& options = LandmarkStreamOptions());
+            LandmarkStreamWriter(const LandmarkStreamWriter& other) = delete;
+            LandmarkStreamWriter& operator=(const LandmarkStreamWriter& other) = delete;
+
+            /*
+            Close the file if not done yet
+            */
+            ~LandmarkStreamWriter();
+
+            bool isOpened() const;
+
+            /*
+            Append the next frame (timestamp in any unit, e.g. microseconds).
+            Blocks while queueCapacity frames are waiting.
+            */
+            void write(long long timestamp, const FaceResult& result);
+
+            /*
+            Write the remaining frames and the index, then stop the writer thread
+            */
+            void close();
+
+
+        private:
+            /*
+            One frame as queued for the writer thread
+            */
+            struct FrameRecord {
+                int64_t timestamp;
+                float presence;
+                uint8_t flags;
+                int32_t rois[LANDMARK_ROIS_PER_FRAME * 4];
+                float points[LANDMARK_POINTS_PER_FRAME * 2];
+            };
+
+            void runWriter();
+            void writeChunk();
+            void writeBytes(const void* data, size_t bytes);
+
+
+        private:
+            std::ofstream m_file;
+            LandmarkFileHeader m_header;
+            uint64_t m_offset;
+
+            BoundedQueue<FrameRecord> m_queue;
+            std::thread m_writerThread;
+            bool m_closed;
+
+            /*
+            Owned by the writer thread
+            */
+            std::vector<FrameRecord> m_chunk;
+            std::vector<uint8_t> m_payload;
+            std::vector<LandmarkIndexEntry> m_index;
+    };
+
+    /*
+    Replay a binary landmark file through a read-only memory mapping.
+    The chunk of the last frame read is decoded once and cached, so sequential reads are cheap.
+    This class is non-copyable and not thread-safe.
+    */
+    class LandmarkStreamReader {
+        public:
+            LandmarkStreamReader(const std::string& path);
+            LandmarkStreamReader(const LandmarkStreamReader& other) = delete;
+            LandmarkStreamReader& operator=(const LandmarkStreamReader& other) = delete;
+            ~LandmarkStreamReader();
+
+            bool isOpened() const;
+
+            long long getFrameCount() const;
+
+            /*
+            Get frame at index. Return false if index is out of range.
+            */
+            bool read(long long index, FaceResult& result, long long* timestamp = nullptr);
+
+            /*
+            Get index of the first frame with a timestamp >= timestamp, -1 if there is none
+            (timestamps must be increasing)
+            */
+            long long findFrame(long long timestamp);
+
+
+        private:
+            /*
+            Rebuild the index from the chunk headers (file not closed by the writer)
+            */
+            bool scanChunks();
+
+            /*
+            Decode chunk i into m_decoded (points) and the array pointers below
+            */
+            bool loadChunk(size_t i);
+
+            void unmap();
+
+
+        private:
+            const uint8_t* m_data;
+            size_t m_size;
+#if defined(_WIN32)
+            void* m_fileHandle;
+            void* m_mappingHandle;
+#else
+            int m_fd;
+#endif
+
+            LandmarkFileHeader m_header;
+            std::vector<LandmarkIndexEntry> m_index;
+            long long m_frameCount;
+
+            /*
+            Cached chunk
+            */
+            long long m_cachedChunk;
+            int m_chunkFrames;
+            const int64_t* m_timestamps;
+            const float* m_presence;
+            const uint8_t* m_flags;
+            const int32_t* m_rois;
+            std::vector<float> m_decoded;
+    };
+}
+
+#endif // LANDMARKSTREAM_H
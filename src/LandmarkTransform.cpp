@@ -0,0 +1,73 @@
+#include "LandmarkTransform.hpp"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define USE_SSE2 1
+#endif
+
+
+void my::transformLandmarks(const float* raw, int count, const cv::Size& inputSize, 
+                            const cv::Rect2f& roi, float* out, bool mirror) {
+    float scaleX = roi.width / inputSize.width;
+    float scaleY = roi.height / inputSize.height;
+
+    /*
+    out = raw * scale + offset, with the (x, y, z) pattern of scale and offset repeated
+    */
+    const float scale[3] = {mirror ? -scaleX : scaleX, scaleY, scaleX};
+    const float offset[3] = {mirror ? roi.x + inputSize.width * scaleX : roi.x, roi.y, 0.f};
+
+    int n = count * 3;
+    int i = 0;
+
+#if USE_SSE2
+    /*
+    4 landmarks (12 floats) per iteration: the pattern is realigned every 3 registers
+    */
+    const __m128 scale0 = _mm_setr_ps(scale[0], scale[1], scale[2], scale[0]);
+    const __m128 scale1 = _mm_setr_ps(scale[1], scale[2], scale[0], scale[1]);
+    const __m128 scale2 = _mm_setr_ps(scale[2], scale[0], scale[1], scale[2]);
+    const __m128 offset0 = _mm_setr_ps(offset[0], offset[1], offset[2], offset[0]);
+    const __m128 offset1 = _mm_setr_ps(offset[1], offset[2], offset[0], offset[1]);
+    const __m128 offset2 = _mm_setr_ps(offset[2], offset[0], offset[1], offset[2]);
+
+    for (; i + 12 <= n; i += 12) {
+        __m128 v0 = _mm_loadu_ps(raw + i);
+        __m128 v1 = _mm_loadu_ps(raw + i + 4);
+        __m128 v2 = _mm_loadu_ps(raw + i + 8);
+        _mm_storeu_ps(out + i, _mm_add_ps(_mm_mul_ps(v0, scale0), offset0));
+        _mm_storeu_ps(out + i + 4, _mm_add_ps(_mm_mul_ps(v1, scale1), offset1));
+        _mm_storeu_ps(out + i + 8, _mm_add_ps(_mm_mul_ps(v2, scale2), offset2));
+    }
+#endif
+    for (; i < n; ++i) {
+        out[i] = raw[i] * scale[i % 3] + offset[i % 3];
+    }
+}
+
+
+void my::transformLandmarks(const float* raw, int count, const cv::Size& inputSize, 
+                            const cv::RotatedRect& roi, float* out) {
+    if (roi.angle == 0.f) {
+        auto topLeft = roi.center - cv::Point2f(roi.size.width, roi.size.height) * 0.5f;
+        transformLandmarks(raw, count, inputSize, cv::Rect2f(topLeft, roi.size), out);
+        return;
+    }
+
+    float scaleX = roi.size.width / inputSize.width;
+    float scaleY = roi.size.height / inputSize.height;
+    float angle = roi.angle * (float)CV_PI / 180.f;
+    float cosA = std::cos(angle);
+    float sinA = std::sin(angle);
+
+    for (int i = 0; i < count; ++i) {
+        float lx = raw[i * 3] * scaleX - 0.5f * roi.size.width;
+        float ly = raw[i * 3 + 1] * scaleY - 0.5f * roi.size.height;
+        float z = raw[i * 3 + 2] * scaleX;
+        out[i * 3] = roi.center.x + lx * cosA - ly * sinA;
+        out[i * 3 + 1] = roi.center.y + lx * sinA + ly * cosA;
+        out[i * 3 + 2] = z;
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef LANDMARKTRANSFORM_H
+#define LANDMARKTRANSFORM_H
+
+#include "opencv2/core.hpp"
+
+namespace my {
+
+    /*
+    Convert count raw landmarks (x, y, z in pixels of an input tensor of inputSize) 
+    to sub-pixel positions in the frame the Roi was cropped from:
+        x = rawX * roi.width / inputSize.width + roi.x   (mirror: inputSize.width - rawX instead of rawX)
+        y = rawY * roi.height / inputSize.height + roi.y
+        z = rawZ * roi.width / inputSize.width           (same scale as x, as Mediapipe does)
+    raw and out hold count * 3 floats, out may be raw.
+    */
+    void transformLandmarks(const float* raw, int count, const cv::Size& inputSize, 
+                            const cv::Rect2f& roi, float* out, bool mirror = false);
+
+    /*
+    Same for a Roi sampled rotated by roi.angle degrees around its center (see ModelLoader::loadRoiToInput):
+        (lx, ly) = (rawX * roi.size.width / inputSize.width, rawY * roi.size.height / inputSize.height) - roi.size / 2
+        x, y = roi.center + (lx * cos - ly * sin, lx * sin + ly * cos)
+        z = rawZ * roi.size.width / inputSize.width
+    */
+    void transformLandmarks(const float* raw, int count, const cv::Size& inputSize, 
+                            const cv::RotatedRect& roi, float* out);
+}
+
+#endif // LANDMARKTRANSFORM_H
@@ -0,0 +1,306 @@
+#include "Metrics.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+/*
+Helper functions
+*/
+int highestBit(uint64_t value) {
+    int bit = 0;
+    for (int shift = 32; shift > 0; shift >>= 1) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+}
+
+
+int streamToSlot(int streamId) {
+    if (streamId < 0) return 0;
+    return std::min(streamId + 1, METRICS_MAX_STREAMS - 1);
+}
+
+
+std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '\\' || c == '"') escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+
+thread_local int t_currentStream = -1;
+std::atomic<bool> my::Metrics::s_enabled(false);
+
+
+my::LatencyHistogram::LatencyHistogram(): m_count(0), m_sum(0), m_max(0) {
+    for (auto& bucket : m_buckets) bucket.store(0, std::memory_order_relaxed);
+}
+
+
+void my::LatencyHistogram::record(uint64_t nanoseconds) {
+    m_buckets[getBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (nanoseconds > max && 
+        !m_max.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed));
+}
+
+
+uint64_t my::LatencyHistogram::getCount() const {
+    return m_count.load(std::memory_order_relaxed);
+}
+
+
+uint64_t my::LatencyHistogram::getSum() const {
+    return m_sum.load(std::memory_order_relaxed);
+}
+
+
+uint64_t my::LatencyHistogram::getMax() const {
+    return m_max.load(std::memory_order_relaxed);
+}
+
+
+uint64_t my::LatencyHistogram::getQuantile(double q) const {
+    /*
+    Buckets are read one by one while other threads record, so the total is summed here
+    instead of using m_count.
+    */
+    uint64_t counts[METRICS_NUM_BUCKETS];
+    uint64_t total = 0;
+    for (int i = 0; i < METRICS_NUM_BUCKETS; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+    if (total == 0) return 0;
+
+    uint64_t rank = (uint64_t)(q * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < METRICS_NUM_BUCKETS; ++i) {
+        seen += counts[i];
+        if (seen >= rank) 
+            return std::min(getBucketMiddle(i), getMax());
+    }
+    return getMax();
+}
+
+//-------------------Private methods start here-------------------
+
+int my::LatencyHistogram::getBucket(uint64_t value) {
+    if (value < METRICS_SUB_BUCKETS) return (int)value;
+
+    /*
+    exponent >= 4, the 4 bits below the highest one select the sub-bucket
+    */
+    int exponent = highestBit(value);
+    int sub = (int)(value >> (exponent - 4)) & (METRICS_SUB_BUCKETS - 1);
+    int bucket = (exponent - 3) * METRICS_SUB_BUCKETS + sub;
+    return std::min(bucket, METRICS_NUM_BUCKETS - 1);
+}
+
+
+uint64_t my::LatencyHistogram::getBucketMiddle(int bucket) {
+    if (bucket < METRICS_SUB_BUCKETS) return bucket;
+
+    int exponent = bucket / METRICS_SUB_BUCKETS + 3;
+    int sub = bucket % METRICS_SUB_BUCKETS;
+    uint64_t width = 1ull << (exponent - 4);
+    return (METRICS_SUB_BUCKETS + sub) * width + width / 2;
+}
+
+
+my::Metrics& my::Metrics::getInstance() {
+    static Metrics instance;
+    return instance;
+}
+
+
+my::Metrics::~Metrics() {
+    stopPeriodicDump();
+    for (auto& stage : m_histograms) {
+        for (auto& histogram : stage) {
+            delete histogram.load();
+        }
+    }
+}
+
+
+void my::Metrics::setEnabled(bool enabled) {
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+
+int my::Metrics::registerStage(const std::string& name) {
+    std::lock_guard<std::mutex> lock(m_registerMutex);
+    int numStages = m_numStages.load(std::memory_order_relaxed);
+    for (int i = 0; i < numStages; ++i) {
+        if (m_stageNames[i] == name) return i;
+    }
+    if (numStages >= METRICS_MAX_STAGES) return -1;
+
+    m_stageNames[numStages] = name;
+    m_numStages.store(numStages + 1, std::memory_order_release);
+    return numStages;
+}
+
+
+void my::Metrics::record(int stageId, uint64_t nanoseconds) {
+    if (stageId < 0 || stageId >= METRICS_MAX_STAGES) return;
+    getHistogram(stageId, streamToSlot(t_currentStream))->record(nanoseconds);
+}
+
+
+void my::Metrics::setCurrentStream(int streamId) {
+    t_currentStream = streamId;
+}
+
+
+int my::Metrics::getCurrentStream() {
+    return t_currentStream;
+}
+
+
+std::vector<my::StageSnapshot> my::Metrics::getSnapshot() const {
+    std::vector<StageSnapshot> snapshot;
+    int numStages = m_numStages.load(std::memory_order_acquire);
+
+    for (int stage = 0; stage < numStages; ++stage) {
+        for (int slot = 0; slot < METRICS_MAX_STREAMS; ++slot) {
+            auto histogram = m_histograms[stage][slot].load(std::memory_order_acquire);
+            if (histogram == nullptr || histogram->getCount() == 0) continue;
+
+            StageSnapshot s;
+            {
+                std::lock_guard<std::mutex> lock(m_registerMutex);
+                s.stage = m_stageNames[stage];
+            }
+            s.stream = slot - 1;
+            s.count = histogram->getCount();
+            s.sum = histogram->getSum() * 1e-9;
+            s.max = histogram->getMax() * 1e-9;
+            s.p50 = histogram->getQuantile(0.5) * 1e-9;
+            s.p90 = histogram->getQuantile(0.9) * 1e-9;
+            s.p99 = histogram->getQuantile(0.99) * 1e-9;
+            s.p999 = histogram->getQuantile(0.999) * 1e-9;
+            snapshot.push_back(s);
+        }
+    }
+    return snapshot;
+}
+
+
+std::string my::Metrics::toText() const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1);
+    out << std::left << std::setw(32) << "stage" << std::right << std::setw(7) << "stream" 
+        << std::setw(10) << "count" << std::setw(11) << "mean(us)" << std::setw(10) << "p50(us)" 
+        << std::setw(10) << "p90(us)" << std::setw(10) << "p99(us)" << std::setw(11) << "max(us)" << "\n";
+
+    for (const auto& s : getSnapshot()) {
+        out << std::left << std::setw(32) << s.stage << std::right << std::setw(7) << s.stream 
+            << std::setw(10) << s.count << std::setw(11) << s.sum / s.count * 1e6 
+            << std::setw(10) << s.p50 * 1e6 << std::setw(10) << s.p90 * 1e6 
+            << std::setw(10) << s.p99 * 1e6 << std::setw(11) << s.max * 1e6 << "\n";
+    }
+    return out.str();
+}
+
+
+std::string my::Metrics::toPrometheus() const {
+    std::ostringstream out;
+    out << std::setprecision(9);
+    out << "# HELP facemesh_stage_latency_seconds Latency of a pipeline stage.\n";
+    out << "# TYPE facemesh_stage_latency_seconds summary\n";
+
+    for (const auto& s : getSnapshot()) {
+        std::string labels = "stage=\"" + escapeLabel(s.stage) + "\",stream=\"" + std::to_string(s.stream) + "\"";
+        const std::pair<const char*, double> quantiles[] = {
+            {"0.5", s.p50}, {"0.9", s.p90}, {"0.99", s.p99}, {"0.999", s.p999}
+        };
+        for (const auto& quantile : quantiles) {
+            out << "facemesh_stage_latency_seconds{" << labels << ",quantile=\"" 
+                << quantile.first << "\"} " << quantile.second << "\n";
+        }
+        out << "facemesh_stage_latency_seconds_sum{" << labels << "} " << s.sum << "\n";
+        out << "facemesh_stage_latency_seconds_count{" << labels << "} " << s.count << "\n";
+    }
+    return out.str();
+}
+
+
+void my::Metrics::startPeriodicDump(const std::string& path, int intervalMs, bool prometheus) {
+    stopPeriodicDump();
+    m_dumpStop = false;
+
+    m_dumpThread = std::thread([this, path, intervalMs, prometheus]() {
+        std::unique_lock<std::mutex> lock(m_dumpMutex);
+        while (!m_dumpStop) {
+            m_dumpWake.wait_for(lock, std::chrono::milliseconds(intervalMs), [this] {return m_dumpStop;});
+
+            lock.unlock();
+            writeDump(path, prometheus);
+            lock.lock();
+        }
+    });
+}
+
+
+void my::Metrics::stopPeriodicDump() {
+    {
+        std::lock_guard<std::mutex> lock(m_dumpMutex);
+        m_dumpStop = true;
+    }
+    m_dumpWake.notify_all();
+    if (m_dumpThread.joinable()) m_dumpThread.join();
+}
+
+//-------------------Private methods start here-------------------
+
+my::Metrics::Metrics(): m_numStages(0), m_dumpStop(true) {
+    for (auto& stage : m_histograms) {
+        for (auto& histogram : stage) histogram.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+
+my::LatencyHistogram* my::Metrics::getHistogram(int stageId, int streamSlot) {
+    auto& slot = m_histograms[stageId][streamSlot];
+    auto histogram = slot.load(std::memory_order_acquire);
+    if (histogram != nullptr) return histogram;
+
+    /*
+    First recording of this stage/stream: the loser of a race frees its copy
+    */
+    auto created = new LatencyHistogram();
+    if (slot.compare_exchange_strong(histogram, created, std::memory_order_acq_rel))
+        return created;
+    delete created;
+    return histogram;
+}
+
+
+void my::Metrics::writeDump(const std::string& path, bool prometheus) const {
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream file(tmpPath, std::ios::trunc);
+        if (!file) return;
+        file << (prometheus ? toPrometheus() : toText());
+    }
+    /*
+    rename replaces the old dump atomically on POSIX, Windows needs it removed first
+    */
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::remove(path.c_str());
+        std::rename(tmpPath.c_str(), path.c_str());
+    }
+}
@@ -0,0 +1,214 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+Build with -DENABLE_METRICS=0 to remove all instrumentation at compile time.
+Otherwise, recording costs one relaxed atomic load while Metrics is disabled at runtime.
+*/
+#ifndef ENABLE_METRICS
+    #define ENABLE_METRICS 1
+#endif
+
+#define METRICS_MAX_STAGES      64
+#define METRICS_MAX_STREAMS     64
+#define METRICS_SUB_BUCKETS     16
+#define METRICS_NUM_BUCKETS     (40 * METRICS_SUB_BUCKETS)
+
+namespace my {
+
+    /*
+    A lock-free latency histogram with log-linear buckets (HDR style):
+    16 linear sub-buckets per power of 2, i.e. about 6% relative precision, from 1ns to 2^43ns (~2.4 hours).
+    Longer values are counted in the last bucket.
+    */
+    class LatencyHistogram {
+        public:
+            LatencyHistogram();
+
+            void record(uint64_t nanoseconds);
+
+            uint64_t getCount() const;
+            uint64_t getSum() const;
+            uint64_t getMax() const;
+
+            /*
+            Get the value (in nanoseconds) at quantile q in [0..1]
+            */
+            uint64_t getQuantile(double q) const;
+
+
+        private:
+            static int getBucket(uint64_t value);
+            static uint64_t getBucketMiddle(int bucket);
+
+
+        private:
+            std::atomic<uint64_t> m_buckets[METRICS_NUM_BUCKETS];
+            std::atomic<uint64_t> m_count;
+            std::atomic<uint64_t> m_sum;
+            std::atomic<uint64_t> m_max;
+    };
+
+    /*
+    Values of one stage of one stream at snapshot time (all durations in seconds).
+    stream is -1 for work not attached to any stream.
+    */
+    struct StageSnapshot {
+        std::string stage;
+        int stream;
+        uint64_t count;
+        double sum;
+        double max;
+        double p50;
+        double p90;
+        double p99;
+        double p999;
+    };
+
+    /*
+    Process-wide latency metrics of every pipeline stage, per stream.
+    Stages are registered once by name (slow path), then recorded by id without locks.
+    The stream of a recording is the current stream of the calling thread (see setCurrentStream).
+    This class is thread-safe and non-copyable.
+    */
+    class Metrics {
+        public:
+            static Metrics& getInstance();
+
+            Metrics(const Metrics& other) = delete;
+            Metrics& operator=(const Metrics& other) = delete;
+            ~Metrics();
+
+            /*
+            Recording is disabled by default
+            */
+            static bool isEnabled() {
+                return s_enabled.load(std::memory_order_relaxed);
+            }
+            void setEnabled(bool enabled);
+
+            /*
+            Get the id of stage name, registering it if needed.
+            Return -1 when METRICS_MAX_STAGES stages are already registered.
+            */
+            int registerStage(const std::string& name);
+
+            /*
+            Record a duration of stage for the current stream of this thread
+            */
+            void record(int stageId, uint64_t nanoseconds);
+
+            /*
+            Attach the work of the calling thread to streamId (-1: no stream).
+            Streams >= METRICS_MAX_STREAMS - 1 share the last slot.
+            */
+            static void setCurrentStream(int streamId);
+            static int getCurrentStream();
+
+            /*
+            Get all stages/streams that recorded at least one value
+            */
+            std::vector<StageSnapshot> getSnapshot() const;
+
+            /*
+            Format a snapshot as plain text or Prometheus exposition format
+            */
+            std::string toText() const;
+            std::string toPrometheus() const;
+
+            /*
+            Write toText() (or toPrometheus()) to path every intervalMs in a background thread.
+            The file is replaced atomically, so readers never see a partial dump.
+            */
+            void startPeriodicDump(const std::string& path, int intervalMs, bool prometheus = true);
+            void stopPeriodicDump();
+
+
+        private:
+            Metrics();
+
+            LatencyHistogram* getHistogram(int stageId, int streamSlot);
+            void writeDump(const std::string& path, bool prometheus) const;
+
+
+        private:
+            static std::atomic<bool> s_enabled;
+
+            /*
+            Registered stage names, m_numStages only grows
+            */
+            mutable std::mutex m_registerMutex;
+            std::string m_stageNames[METRICS_MAX_STAGES];
+            std::atomic<int> m_numStages;
+
+            /*
+            Histograms are allocated on first use of a stage/stream pair
+            */
+            std::atomic<LatencyHistogram*> m_histograms[METRICS_MAX_STAGES][METRICS_MAX_STREAMS];
+
+            std::thread m_dumpThread;
+            std::mutex m_dumpMutex;
+            std::condition_variable m_dumpWake;
+            bool m_dumpStop;
+    };
+
+    /*
+    Record the lifetime of this object to a stage (nothing happens while Metrics is disabled).
+    */
+    class ScopedTimer {
+        public:
+            ScopedTimer(int stageId): m_stageId(stageId), m_active(Metrics::isEnabled() && stageId >= 0) {
+                if (m_active) m_start = std::chrono::steady_clock::now();
+            }
+            ~ScopedTimer() {
+                if (m_active) {
+                    auto elapsed = std::chrono::steady_clock::now() - m_start;
+                    Metrics::getInstance().record(m_stageId, 
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+                }
+            }
+            ScopedTimer(const ScopedTimer& other) = delete;
+            ScopedTimer& operator=(const ScopedTimer& other) = delete;
+
+        private:
+            int m_stageId;
+            bool m_active;
+            std::chrono::steady_clock::time_point m_start;
+    };
+
+    /*
+    Wall time since construction, for code that needs the duration itself (whatever ENABLE_METRICS)
+    */
+    class Stopwatch {
+        public:
+            Stopwatch(): m_start(std::chrono::steady_clock::now()) {}
+
+            float getElapsedMs() const {
+                auto elapsed = std::chrono::steady_clock::now() - m_start;
+                return std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count() / 1000.f;
+            }
+
+        private:
+            std::chrono::steady_clock::time_point m_start;
+    };
+}
+
+/*
+Time the rest of the enclosing scope as stageId
+*/
+#if ENABLE_METRICS
+    #define METRICS_SCOPE(stageId) my::ScopedTimer __metricsTimer(stageId)
+#else
+    #define METRICS_SCOPE(stageId) ((void)0)
+#endif
+
+#endif // METRICS_H
@@ -1,22 +1,282 @@
 #include "ModelLoader.hpp"
+#include "ModelRegistry.hpp"
+#include "Metrics.hpp"
+#include "HalfFloat.hpp"
 
 #include <iostream>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <limits>
 
 #include "tensorflow/lite/builtin_op_data.h"
 #include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
 
 #define INPUT_NORM_MEAN 127.5f
 #define INPUT_NORM_STD  127.5f
 
+/*
+Tensors above this size are allocated at runtime when dynamic tensors are allowed
+*/
+#define DYNAMIC_TENSOR_THRESHOLD (1 << 20)
+
+/*
+Helper functions
+*/
+template <class T>
+T saturateRound(float value) {
+    float rounded = std::floor(value + 0.5f);
+    rounded = std::max(rounded, (float)std::numeric_limits<T>::lowest());
+    rounded = std::min(rounded, (float)std::numeric_limits<T>::max());
+    return (T)rounded;
+}
+
+
+/*
+Bilinear sampling of in through table into an HxWx3 RGB tensor,
+each channel is stored as store(value * scale + shift)
+*/
+template <class T, class Store>
+void sampleImage(const cv::Mat& in, const my::ResizeTable& table, T* out, 
+                 int H, int W, bool mirror, float scale, float shift, Store store) {
+    /*
+    When mirroring, the output row is written from right to left
+    */
+    const int step = mirror ? -3 : 3;
+    if (mirror) out += (W - 1) * 3;
+
+    for (int y = 0; y < H; ++y) {
+        const uchar* row0 = in.ptr<uchar>(table.y0[y]);
+        const uchar* row1 = in.ptr<uchar>(table.y1[y]);
+        float wy = table.wy[y];
+
+        for (int x = 0; x < W; ++x) {
+            const uchar* p00 = row0 + table.x0[x];
+            const uchar* p01 = row0 + table.x1[x];
+            const uchar* p10 = row1 + table.x0[x];
+            const uchar* p11 = row1 + table.x1[x];
+            float wx = table.wx[x];
+
+            for (int c = 0; c < 3; ++c) {
+                float top = p00[c] + (p01[c] - p00[c]) * wx;
+                float bottom = p10[c] + (p11[c] - p10[c]) * wx;
+                out[2 - c] = store((top + (bottom - top) * wy) * scale + shift);
+            }
+            out += step;
+        }
+        out += mirror ? 2 * W * 3 : 0;
+    }
+}
+
+
+/*
+Bilinear sampling of the parallelogram affine maps the HxW tensor to (source pixel (x, y) =
+(a[0]*u + a[1]*v + a[2], a[3]*u + a[4]*v + a[5]) for tensor pixel (u, v)) into an HxWx3 RGB tensor,
+source pixels outside in are black. Each channel is stored as store(value * scale + shift)
+*/
+template <class T, class Store>
+void sampleAffine(const cv::Mat& in, int channels, const float* a, T* out, 
+                  int H, int W, float scale, float shift, Store store) {
+    const uchar black[4] = {0, 0, 0, 0};
+    const int maxX = in.cols - 1;
+    const int maxY = in.rows - 1;
+    const size_t rowStep = in.step;
+
+    auto pixelAt = [&](int x, int y) {
+        if (x < 0 || y < 0 || x > maxX || y > maxY) return black;
+        return in.ptr<uchar>(y) + x * channels;
+    };
+
+    for (int v = 0; v < H; ++v) {
+        float rowX = a[1] * v + a[2];
+        float rowY = a[4] * v + a[5];
+
+        for (int u = 0; u < W; ++u) {
+            float sx = a[0] * u + rowX;
+            float sy = a[3] * u + rowY;
+            int x = cvFloor(sx);
+            int y = cvFloor(sy);
+            float wx = sx - x;
+            float wy = sy - y;
+
+            const uchar *p00, *p01, *p10, *p11;
+            if (x >= 0 && y >= 0 && x < maxX && y < maxY) {
+                p00 = in.ptr<uchar>(y) + x * channels;
+                p01 = p00 + channels;
+                p10 = p00 + rowStep;
+                p11 = p10 + channels;
+            }
+            else {
+                /*
+                Border: taps outside the image are black, as in the zero-padded crop
+                */
+                p00 = pixelAt(x, y);
+                p01 = pixelAt(x + 1, y);
+                p10 = pixelAt(x, y + 1);
+                p11 = pixelAt(x + 1, y + 1);
+            }
+
+            for (int c = 0; c < 3; ++c) {
+                float top = p00[c] + (p01[c] - p00[c]) * wx;
+                float bottom = p10[c] + (p11[c] - p10[c]) * wx;
+                out[2 - c] = store((top + (bottom - top) * wy) * scale + shift);
+            }
+            out += 3;
+        }
+    }
+}
+
+
+/*
+Bilinear Y, U and V at the 4 taps (x0, y0), (x1, y0), (x0, y1), (x1, y1) of a YUV frame, converted to RGB once.
+The conversion is affine, so this is converting the taps then interpolating (up to clamping).
+*/
+inline void sampleYuvPixel(const my::YuvPlanes& in, int x0, int x1, int y0, int y1, float wx, float wy, float* rgb) {
+    auto interpolate = [wx, wy](float p00, float p01, float p10, float p11) {
+        float top = p00 + (p01 - p00) * wx;
+        float bottom = p10 + (p11 - p10) * wx;
+        return top + (bottom - top) * wy;
+    };
+    float y = interpolate(in.getY(x0, y0), in.getY(x1, y0), in.getY(x0, y1), in.getY(x1, y1));
+    float u = interpolate(in.getU(x0, y0), in.getU(x1, y0), in.getU(x0, y1), in.getU(x1, y1));
+    float v = interpolate(in.getV(x0, y0), in.getV(x1, y0), in.getV(x0, y1), in.getV(x1, y1));
+    my::yuvToRgb(y, u, v, rgb);
+}
+
+
+/*
+Same as sampleImage for a YUV frame (table offsets are pixel indices)
+*/
+template <class T, class Store>
+void sampleYuvImage(const my::YuvPlanes& in, const my::ResizeTable& table, T* out, 
+                    int H, int W, bool mirror, float scale, float shift, Store store) {
+    const int step = mirror ? -3 : 3;
+    if (mirror) out += (W - 1) * 3;
+
+    float rgb[3];
+    for (int y = 0; y < H; ++y) {
+        for (int x = 0; x < W; ++x) {
+            sampleYuvPixel(in, table.x0[x], table.x1[x], table.y0[y], table.y1[y], table.wx[x], table.wy[y], rgb);
+            for (int c = 0; c < 3; ++c) {
+                out[c] = store(rgb[c] * scale + shift);
+            }
+            out += step;
+        }
+        out += mirror ? 2 * W * 3 : 0;
+    }
+}
+
+
+/*
+Same as sampleAffine for a YUV frame, taps outside the frame are black (Y = 16, U = V = 128)
+*/
+template <class T, class Store>
+void sampleYuvAffine(const my::YuvPlanes& in, const float* a, T* out, 
+                     int H, int W, float scale, float shift, Store store) {
+    const int maxX = in.size.width - 1;
+    const int maxY = in.size.height - 1;
+
+    auto tapAt = [&](int x, int y, float* yuv) {
+        bool isInside = x >= 0 && y >= 0 && x <= maxX && y <= maxY;
+        yuv[0] = isInside ? in.getY(x, y) : 16.f;
+        yuv[1] = isInside ? in.getU(x, y) : 128.f;
+        yuv[2] = isInside ? in.getV(x, y) : 128.f;
+    };
+
+    float rgb[3];
+    for (int v = 0; v < H; ++v) {
+        float rowX = a[1] * v + a[2];
+        float rowY = a[4] * v + a[5];
+
+        for (int u = 0; u < W; ++u) {
+            float sx = a[0] * u + rowX;
+            float sy = a[3] * u + rowY;
+            int x = cvFloor(sx);
+            int y = cvFloor(sy);
+            float wx = sx - x;
+            float wy = sy - y;
+
+            if (x >= 0 && y >= 0 && x < maxX && y < maxY) {
+                sampleYuvPixel(in, x, x + 1, y, y + 1, wx, wy, rgb);
+            }
+            else {
+                float p00[3], p01[3], p10[3], p11[3];
+                tapAt(x, y, p00);
+                tapAt(x + 1, y, p01);
+                tapAt(x, y + 1, p10);
+                tapAt(x + 1, y + 1, p11);
+
+                float yuv[3];
+                for (int c = 0; c < 3; ++c) {
+                    float top = p00[c] + (p01[c] - p00[c]) * wx;
+                    float bottom = p10[c] + (p11[c] - p10[c]) * wx;
+                    yuv[c] = top + (bottom - top) * wy;
+                }
+                my::yuvToRgb(yuv[0], yuv[1], yuv[2], rgb);
+            }
+
+            for (int c = 0; c < 3; ++c) {
+                out[c] = store(rgb[c] * scale + shift);
+            }
+            out += 3;
+        }
+    }
+}
 
-my::ModelLoader::ModelLoader(std::string modelPath) {
+
+/*
+Call kernel(out, scale, shift, store) with the data of input (at element offset) and the
+store function of its type. Quantization is folded into scale and shift: 
+q = (value * scale + shift) / qScale + zeroPoint
+*/
+template <class Kernel>
+void dispatchInputType(const my::TensorWrapper& input, size_t offset, float scale, float shift, Kernel kernel) {
+    switch (input.type) {
+        case kTfLiteFloat32:
+            kernel(input.data + offset, scale, shift, [](float v) {return v;});
+            break;
+        case kTfLiteFloat16:
+            kernel(static_cast<uint16_t*>(input.raw) + offset, scale, shift, 
+                [](float v) {return my::floatToHalf(v);});
+            break;
+        case kTfLiteUInt8:
+        case kTfLiteInt8: {
+            const auto& q = input.quantization;
+            scale /= q.scale;
+            shift = shift / q.scale + q.zeroPoint;
+            if (input.type == kTfLiteUInt8)
+                kernel(static_cast<uint8_t*>(input.raw) + offset, scale, shift, 
+                    [](float v) {return saturateRound<uint8_t>(v);});
+            else
+                kernel(static_cast<int8_t*>(input.raw) + offset, scale, shift, 
+                    [](float v) {return saturateRound<int8_t>(v);});
+            break;
+        }
+        default:
+            std::cerr << "Input of type " << input.type << " not supported" << std::endl;
+            std::exit(1);
+    }
+}
+
+
+my::ModelLoader::ModelLoader(std::string modelPath, const InterpreterOptions& options):
+    m_options(InterpreterTuner::getInstance().resolve(modelPath, options)),
+    m_delegate(nullptr, TfLiteXNNPackDelegateDelete),
+    m_pixelFormat(PixelFormat::BGR)
+{
     loadModel(modelPath.c_str());
-    buildInterpreter();
+    buildInterpreter(m_options);
     allocateTensors();
     fillInputTensors();
     fillOutputTensors();
 
     m_inputLoads.resize(getNumberOfInputs(), false);
+    m_resizeTables.resize(getNumberOfInputs());
+
+    auto modelName = std::filesystem::path(modelPath).stem().string();
+    m_preprocessStage = Metrics::getInstance().registerStage(modelName + ".preprocess");
+    m_invokeStage = Metrics::getInstance().registerStage(modelName + ".invoke");
 }
 
 
@@ -28,6 +288,14 @@ std::vector<int> my::ModelLoader::getInputShape(int index) const {
 }
 
 
+cv::Size my::ModelLoader::getInputImageSize(int index) const {
+    if (isIndexValid(index, 'i') && m_inputs[index].dims.size() >= 3)
+        return cv::Size(m_inputs[index].dims[2], m_inputs[index].dims[1]);
+
+    return cv::Size();
+}
+
+
 float* my::ModelLoader::getInputData(int index) const {
     if (isIndexValid(index, 'i'))
         return m_inputs[index].data;
@@ -59,7 +327,7 @@ std::vector<int> my::ModelLoader::getOutputShape(int index) const {
 
 float* my::ModelLoader::getOutputData(int index) const {
     if (isIndexValid(index, 'o'))
-        return m_outputs[index].data;
+        return const_cast<float*>(dequantizeOutput(index));
 
     return nullptr;
 }
@@ -78,61 +346,285 @@ int my::ModelLoader::getNumberOfOutputs() const {
 }
 
 
+my::InterpreterOptions my::ModelLoader::getInterpreterOptions() const {
+    return m_options;
+}
+
+
+TfLiteType my::ModelLoader::getInputType(int index) const {
+    if (isIndexValid(index, 'i'))
+        return m_inputs[index].type;
+
+    return kTfLiteNoType;
+}
+
+
+TfLiteType my::ModelLoader::getOutputType(int index) const {
+    if (isIndexValid(index, 'o'))
+        return m_outputs[index].type;
+
+    return kTfLiteNoType;
+}
+
+
+my::QuantizationParams my::ModelLoader::getInputQuantization(int index) const {
+    if (isIndexValid(index, 'i'))
+        return m_inputs[index].quantization;
+
+    return QuantizationParams();
+}
+
+
+my::QuantizationParams my::ModelLoader::getOutputQuantization(int index) const {
+    if (isIndexValid(index, 'o'))
+        return m_outputs[index].quantization;
+
+    return QuantizationParams();
+}
+
+
 void my::ModelLoader::loadImageToInput(const cv::Mat& inputImage, int idx) {
     if (isIndexValid(idx, 'i')) {
-        cv::Mat resizedImage = preprocessImage(inputImage, idx); // Need optimize
-        loadBytesToInput(resizedImage.data, idx);
+        preprocessImage(inputImage, idx);
+        m_inputLoads[idx] = true;
     }
 }
 
 
-void my::ModelLoader::loadBytesToInput(const void* data, int idx) {
+void my::ModelLoader::loadImageToBatch(const cv::Mat& inputImage, int batch, bool mirror, int idx) {
     if (isIndexValid(idx, 'i')) {
-        memcpy(m_inputs[idx].data, data, m_inputs[idx].bytes);
+        if (batch < 0 || batch >= m_inputs[idx].dims[0]) {
+            std::cerr << "Batch " << batch << " is out of range (" \
+            << m_inputs[idx].dims[0] << ")." << std::endl;
+            return;
+        }
+        preprocessImage(inputImage, idx, batch, mirror);
+        m_inputLoads[idx] = true;
+    }
+}
+
+
+void my::ModelLoader::loadRoiToInput(const cv::Mat& inputImage, const cv::RotatedRect& roi, int idx) {
+    if (isIndexValid(idx, 'i')) {
+        preprocessRoi(inputImage, roi, idx);
+        m_inputLoads[idx] = true;
+    }
+}
+
+
+void my::ModelLoader::loadRoiToInput(const cv::Mat& inputImage, const cv::Rect& roi, int idx) {
+    loadRoiToInput(inputImage, toRotatedRect(roi), idx);
+}
+
+
+void my::ModelLoader::loadRoiToBatch(const cv::Mat& inputImage, const cv::RotatedRect& roi, int batch, bool mirror, int idx) {
+    if (isIndexValid(idx, 'i')) {
+        if (batch < 0 || batch >= m_inputs[idx].dims[0]) {
+            std::cerr << "Batch " << batch << " is out of range (" \
+            << m_inputs[idx].dims[0] << ")." << std::endl;
+            return;
+        }
+        preprocessRoi(inputImage, roi, idx, batch, mirror);
         m_inputLoads[idx] = true;
     }
 }
 
 
+void my::ModelLoader::loadRoiToBatch(const cv::Mat& inputImage, const cv::Rect& roi, int batch, bool mirror, int idx) {
+    loadRoiToBatch(inputImage, toRotatedRect(roi), batch, mirror, idx);
+}
+
+
+cv::RotatedRect my::ModelLoader::toRotatedRect(const cv::Rect& roi) {
+    cv::Point2f center(roi.x + roi.width * 0.5f, roi.y + roi.height * 0.5f);
+    return cv::RotatedRect(center, cv::Size2f((float)roi.width, (float)roi.height), 0.f);
+}
+
+
+void my::ModelLoader::resizeInput(const std::vector<int>& dims, int idx) {
+    if (isIndexValid(idx, 'i')) {
+        if (m_interpreter->ResizeInputTensor(m_interpreter->inputs()[idx], dims) != kTfLiteOk) {
+            std::cerr << "Failed to resize input " << idx << "." << std::endl;
+            std::exit(1);
+        }
+        allocateTensors();
+
+        m_inputs.clear();
+        m_outputs.clear();
+        fillInputTensors();
+        fillOutputTensors();
+
+        m_resizeTables[idx] = ResizeTable();
+        std::fill(m_inputLoads.begin(), m_inputLoads.end(), false);
+    }
+}
+
+
+void my::ModelLoader::setNumThreads(int numThreads) {
+    if (numThreads == m_options.numThreads)
+        return;
+
+    m_options.numThreads = numThreads;
+    if (m_options.delegate != DelegateType::XNNPack) {
+        m_interpreter->SetNumThreads(numThreads);
+        return;
+    }
+
+    std::vector<std::vector<int>> inputDims;
+    for (const auto& input: m_inputs) {
+        inputDims.push_back(input.dims);
+    }
+
+    /*
+    The delegate must outlive the interpreter
+    */
+    m_interpreter.reset();
+    m_delegate.reset();
+    buildInterpreter(m_options);
+    for (int i = 0; i < (int)inputDims.size(); ++i) {
+        if (m_interpreter->ResizeInputTensor(m_interpreter->inputs()[i], inputDims[i]) != kTfLiteOk) {
+            std::cerr << "Failed to resize input " << i << "." << std::endl;
+            std::exit(1);
+        }
+    }
+    allocateTensors();
+
+    m_inputs.clear();
+    m_outputs.clear();
+    fillInputTensors();
+    fillOutputTensors();
+
+    /*
+    The shapes are the same, the resize tables are still valid
+    */
+    std::fill(m_inputLoads.begin(), m_inputLoads.end(), false);
+}
+
+
+void my::ModelLoader::setPixelFormat(PixelFormat format) {
+    m_pixelFormat = format;
+}
+
+
+my::PixelFormat my::ModelLoader::getPixelFormat() const {
+    return m_pixelFormat;
+}
+
+
+void my::ModelLoader::loadBytesToInput(const void* data, int idx) {
+    if (isIndexValid(idx, 'i'))
+        loadRawToInput(data, m_inputs[idx].bytes, idx);
+}
+
+
+void my::ModelLoader::loadRawToInput(const void* data, size_t bytes, int idx) {
+    if (!isIndexValid(idx, 'i')) return;
+
+    /*
+    The bytes must already be in the element type of the tensor (no conversion)
+    */
+    if (bytes != m_inputs[idx].bytes) {
+        std::cerr << "Input " << idx << " of type " << m_inputs[idx].type << " needs " \
+        << m_inputs[idx].bytes << " bytes, got " << bytes << "." << std::endl;
+        return;
+    }
+    memcpy(m_inputs[idx].raw, data, bytes);
+    m_inputLoads[idx] = true;
+}
+
+
 void my::ModelLoader::runInference() {
+    METRICS_SCOPE(m_invokeStage);
     inputChecker();
     m_interpreter->Invoke(); // Tflite inference
+    {
+        std::lock_guard<std::mutex> lock(m_dequantizeMutex);
+        std::fill(m_isDequantized.begin(), m_isDequantized.end(), false);
+    }
 }
 
 
 std::vector<float> my::ModelLoader::loadOutput(int index) const {
-    if (isIndexValid(index, 'o')) {
-        int sizeInByte = m_outputs[index].bytes;
-        int sizeInFloat = sizeInByte / sizeof(float);
+    auto output = getOutputView(index);
+    return std::vector<float>(output.begin(), output.end());
+}
 
-        std::vector<float> inference(sizeInFloat);
-        memcpy(&(inference[0]), m_outputs[index].data, sizeInByte);
-        
-        return inference;
+
+my::TensorView<float> my::ModelLoader::getOutputView(int index) const {
+    if (isIndexValid(index, 'o')) {
+        const auto& output = m_outputs[index];
+        return TensorView<float>(dequantizeOutput(index), output.count, output.dims, output.strides);
     }
-    return std::vector<float>();
+    return TensorView<float>();
 }
 
 
 //-------------------Private methods start here-------------------
 
 void my::ModelLoader::loadModel(const char* modelPath) {
-    m_model = tflite::FlatBufferModel::BuildFromFile(modelPath);
+    m_model = ModelRegistry::getInstance().acquire(modelPath);
     if (m_model == nullptr) {
         std::cerr << "Fail to build FlatBufferModel from file: " << modelPath << std::endl;
         std::exit(1);
     }  
+    m_weightsCache = ModelRegistry::getInstance().acquireWeightsCache(modelPath);
 }
 
 
-void my::ModelLoader::buildInterpreter(int numThreads) {
-    tflite::ops::builtin::BuiltinOpResolver resolver;
+void my::ModelLoader::buildInterpreter(const InterpreterOptions& options) {
+    /*
+    BuiltinOpResolver would apply XNNPACK by itself, the delegate is chosen here instead
+    */
+    tflite::ops::builtin::BuiltinOpResolverWithoutDefaultDelegates resolver;
+
+    tflite::InterpreterOptions interpreterOptions;
+    if (options.allowDynamicTensors) {
+        interpreterOptions.SetDynamicAllocationForLargeTensors(DYNAMIC_TENSOR_THRESHOLD);
+        interpreterOptions.SetEnsureDynamicTensorsAreReleased();
+    }
 
-    if (tflite::InterpreterBuilder(*m_model, resolver)(&m_interpreter) != kTfLiteOk) {
+    if (tflite::InterpreterBuilder(*m_model, resolver, &interpreterOptions)(&m_interpreter) != kTfLiteOk) {
         std::cerr << "Failed to build interpreter." << std::endl;
         std::exit(1);
     }
-    m_interpreter->SetNumThreads(numThreads);
+    m_interpreter->SetNumThreads(options.numThreads);
+
+    if (options.delegate == DelegateType::XNNPack) {
+        auto xnnpackOptions = TfLiteXNNPackDelegateOptionsDefault();
+        xnnpackOptions.num_threads = std::max(options.numThreads, 1);
+        xnnpackOptions.weights_cache = m_weightsCache->cache;
+        m_delegate.reset(TfLiteXNNPackDelegateCreate(&xnnpackOptions));
+
+        /*
+        Only the first delegate of the model packs its weights, the others find them in the cache.
+        The cache has to be finalized before any inference (soft: later delegates can still look up).
+        */
+        bool isDelegated;
+        {
+            std::lock_guard<std::mutex> lock(m_weightsCache->mutex);
+            isDelegated = m_interpreter->ModifyGraphWithDelegate(m_delegate.get()) == kTfLiteOk;
+            if (isDelegated && !m_weightsCache->isFinalized) {
+                if (!TfLiteXNNPackDelegateWeightsCacheFinalizeSoft(m_weightsCache->cache)) {
+                    std::cerr << "Failed to finalize the XNNPACK weights cache." << std::endl;
+                    std::exit(1);
+                }
+                m_weightsCache->isFinalized = true;
+            }
+        }
+
+        if (!isDelegated) {
+            /*
+            The graph may be partially modified: start over with builtin ops
+            */
+            std::cerr << "XNNPACK cannot run this model, using builtin ops." << std::endl;
+            InterpreterOptions fallback = options;
+            fallback.delegate = DelegateType::Builtin;
+            m_interpreter.reset();
+            m_delegate.reset();
+            m_options.delegate = DelegateType::Builtin;
+            buildInterpreter(fallback);
+        }
+    }
 }
 
 
@@ -146,31 +638,17 @@ void my::ModelLoader::allocateTensors() {
 
 void my::ModelLoader::fillInputTensors() {
     for (auto input: m_interpreter->inputs()) {
-        TfLiteTensor* inputTensor =  m_interpreter->tensor(input);
-        TfLiteIntArray* dims =  inputTensor->dims;
-
-        m_inputs.push_back({
-            inputTensor->data.f,
-            inputTensor->bytes,
-            dims->data,
-            dims->size
-        });
+        m_inputs.emplace_back(m_interpreter->tensor(input));
     }
 }
 
 
 void my::ModelLoader::fillOutputTensors() {
     for (auto output: m_interpreter->outputs()) {
-        TfLiteTensor* outputTensor =  m_interpreter->tensor(output);
-        TfLiteIntArray* dims =  outputTensor->dims;
-
-        m_outputs.push_back({
-            outputTensor->data.f,
-            outputTensor->bytes,
-            dims->data,
-            dims->size
-        });
+        m_outputs.emplace_back(m_interpreter->tensor(output));
     }
+    m_dequantizedOutputs.assign(m_outputs.size(), std::vector<float>());
+    m_isDequantized.assign(m_outputs.size(), false);
 }
 
 
@@ -214,37 +692,164 @@ void my::ModelLoader::inputChecker() {
 }
 
 
-cv::Mat my::ModelLoader::preprocessImage(const cv::Mat& in, int idx) const {
-    auto out = convertToRGB(in);
-
-    std::vector<int> inputShape = getInputShape(idx);
-    int H = inputShape[1];
-    int W = inputShape[2]; 
+void my::ModelLoader::preprocessImage(const cv::Mat& in, int idx, int batch, bool mirror) {
+    METRICS_SCOPE(m_preprocessStage);
+    int channels = getImageChannels(in);
 
-    cv::Size wantedSize = cv::Size(W, H);
-    cv::resize(out, out, wantedSize);
+    const auto& input = m_inputs[idx];
+    int H = input.dims[1];
+    int W = input.dims[2];
+    size_t offset = (size_t)batch * H * W * 3;
+    const auto& table = getResizeTable(getImageSize(in, m_pixelFormat), channels, idx);
 
     /*
-    Equivalent to (out - mean)/ std
+    Equivalent to cvtColor -> resize -> (out - mean) / std, without temporary images
+    (YUV frames are converted at the sampled pixels only)
     */
-    out.convertTo(out, CV_32FC3, 1 / INPUT_NORM_STD, -INPUT_NORM_MEAN / INPUT_NORM_STD);
-    return out;
+    float scale = 1.f / INPUT_NORM_STD;
+    float shift = -INPUT_NORM_MEAN / INPUT_NORM_STD;
+
+    dispatchInputType(input, offset, scale, shift, [&](auto out, float outScale, float outShift, auto store) {
+        if (m_pixelFormat == PixelFormat::BGR)
+            sampleImage(in, table, out, H, W, mirror, outScale, outShift, store);
+        else
+            sampleYuvImage(getYuvPlanes(in, m_pixelFormat), table, out, H, W, mirror, outScale, outShift, store);
+    });
 }
 
 
-cv::Mat my::ModelLoader::convertToRGB(const cv::Mat& in) const {
-    cv::Mat out;
-    int type = in.type();
+void my::ModelLoader::preprocessRoi(const cv::Mat& in, const cv::RotatedRect& roi, int idx, int batch, bool mirror) {
+    METRICS_SCOPE(m_preprocessStage);
+    int channels = getImageChannels(in);
 
-    if (type == CV_8UC3) {
-        cv::cvtColor(in, out, cv::COLOR_BGR2RGB);
-    }
-    else if (type == CV_8UC4) {
-        cv::cvtColor(in, out, cv::COLOR_BGRA2RGB);
+    const auto& input = m_inputs[idx];
+    int H = input.dims[1];
+    int W = input.dims[2];
+    size_t offset = (size_t)batch * H * W * 3;
+
+    /*
+    Tensor pixel (u, v) samples the Roi at ((u + 0.5) / W, (v + 0.5) / H), rotated around its center,
+    then shifted by half a pixel: the same positions as cv::resize of an axis-aligned crop
+    */
+    float angle = roi.angle * (float)CV_PI / 180.f;
+    float cosA = std::cos(angle);
+    float sinA = std::sin(angle);
+    float stepX = roi.size.width / W;
+    float stepY = roi.size.height / H;
+    float dx = 0.5f * stepX - 0.5f * roi.size.width;
+    float dy = 0.5f * stepY - 0.5f * roi.size.height;
+
+    float affine[6] = {
+        cosA * stepX, -sinA * stepY, roi.center.x - 0.5f + cosA * dx - sinA * dy,
+        sinA * stepX,  cosA * stepY, roi.center.y - 0.5f + sinA * dx + cosA * dy
+    };
+    if (mirror) {
+        affine[2] += affine[0] * (W - 1);
+        affine[5] += affine[3] * (W - 1);
+        affine[0] = -affine[0];
+        affine[3] = -affine[3];
     }
-    else {
-        std::cerr << "Image of type " << type << " not supported" << std::endl;
+
+    float scale = 1.f / INPUT_NORM_STD;
+    float shift = -INPUT_NORM_MEAN / INPUT_NORM_STD;
+
+    dispatchInputType(input, offset, scale, shift, [&](auto out, float outScale, float outShift, auto store) {
+        if (m_pixelFormat == PixelFormat::BGR)
+            sampleAffine(in, channels, affine, out, H, W, outScale, outShift, store);
+        else
+            sampleYuvAffine(getYuvPlanes(in, m_pixelFormat), affine, out, H, W, outScale, outShift, store);
+    });
+}
+
+
+int my::ModelLoader::getImageChannels(const cv::Mat& in) const {
+    if (!isImageValid(in, m_pixelFormat)) {
+        std::cerr << "Image of type " << in.type() << " (" << in.cols << "x" << in.rows << ") not supported" \
+        << " with pixel format " << (int)m_pixelFormat << std::endl;
         std::exit(1);
     }
-    return out;
-}
\ No newline at end of file
+
+    if (m_pixelFormat != PixelFormat::BGR)
+        return 1;
+
+    return in.type() == CV_8UC4 ? 4 : 3;
+}
+
+
+const my::ResizeTable& my::ModelLoader::getResizeTable(const cv::Size& srcSize, int channels, int idx) {
+    int H = m_inputs[idx].dims[1];
+    int W = m_inputs[idx].dims[2];
+
+    auto& table = m_resizeTables[idx];
+    if (table.srcSize == srcSize && table.dstSize == cv::Size(W, H) && table.channels == channels)
+        return table;
+
+    table.srcSize = srcSize;
+    table.dstSize = cv::Size(W, H);
+    table.channels = channels;
+
+    /*
+    Same sampling positions as cv::resize with INTER_LINEAR
+    */
+    auto fillAxis = [](int srcLen, int dstLen, int stride, 
+                       std::vector<int>& i0, std::vector<int>& i1, std::vector<float>& w) {
+        i0.resize(dstLen); i1.resize(dstLen); w.resize(dstLen);
+        float ratio = (float)srcLen / dstLen;
+
+        for (int d = 0; d < dstLen; ++d) {
+            float f = (d + 0.5f) * ratio - 0.5f;
+            int s = (int)std::floor(f);
+            f -= s;
+            if (s < 0) { 
+                s = 0; f = 0.f; 
+            }
+            if (s >= srcLen - 1) {
+                s = srcLen - 1; f = 0.f;
+            }
+            i0[d] = s * stride;
+            i1[d] = std::min(s + 1, srcLen - 1) * stride;
+            w[d] = f;
+        }
+    };
+
+    fillAxis(srcSize.width, W, channels, table.x0, table.x1, table.wx);
+    fillAxis(srcSize.height, H, 1, table.y0, table.y1, table.wy);
+    return table;
+}
+
+
+const float* my::ModelLoader::dequantizeOutput(int idx) const {
+    const auto& output = m_outputs[idx];
+    if (output.type == kTfLiteFloat32) 
+        return output.data;
+
+    std::lock_guard<std::mutex> lock(m_dequantizeMutex);
+    auto& values = m_dequantizedOutputs[idx];
+    if (m_isDequantized[idx]) 
+        return values.data();
+
+    values.resize(output.count);
+    const auto& q = output.quantization;
+    switch (output.type) {
+        case kTfLiteFloat16: {
+            auto raw = static_cast<const uint16_t*>(output.raw);
+            for (size_t i = 0; i < output.count; ++i) values[i] = halfToFloat(raw[i]);
+            break;
+        }
+        case kTfLiteUInt8: {
+            auto raw = static_cast<const uint8_t*>(output.raw);
+            for (size_t i = 0; i < output.count; ++i) values[i] = q.dequantize(raw[i]);
+            break;
+        }
+        case kTfLiteInt8: {
+            auto raw = static_cast<const int8_t*>(output.raw);
+            for (size_t i = 0; i < output.count; ++i) values[i] = q.dequantize(raw[i]);
+            break;
+        }
+        default:
+            std::cerr << "Output of type " << output.type << " not supported" << std::endl;
+            std::exit(1);
+    }
+    m_isDequantized[idx] = true;
+    return values.data();
+}
@@ -3,32 +3,149 @@
 
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
 
 #include "opencv2/core.hpp"
 #include "opencv2/imgproc.hpp"
 #include "tensorflow/lite/interpreter.h"
 #include "tensorflow/lite/model.h"
+#include "InterpreterOptions.hpp"
+#include "PixelFormat.hpp"
 
 namespace my {
 
+    struct SharedWeightsCache;
+
     template <class T>
     using Matrix = std::vector<std::vector<T>>;
 
+    /*
+    Quantization of a tflite tensor: real value = scale * (quantized value - zeroPoint)
+    */
+    struct QuantizationParams {
+        float scale = 1.f;
+        int zeroPoint = 0;
+
+        float dequantize(int value) const { return scale * (value - zeroPoint); }
+    };
+
     /*
     A tensor wrapper to save information of tflite tensors.
     Attributes:
-        data: a float pointer to tensor data
+        data: a float pointer to tensor data (nullptr if the tensor is not float32)
+        raw: a pointer to tensor data of any type
         bytes: size of data in bytes
+        type: element type (kTfLiteFloat32, kTfLiteFloat16, kTfLiteUInt8 or kTfLiteInt8)
+        quantization: quantization params of uint8/int8 tensors
+        count: number of elements
         dims: shape of data tensor
     */
     struct TensorWrapper {
         float* data;
+        void* raw;
         size_t bytes;
+        TfLiteType type;
+        QuantizationParams quantization;
+        size_t count;
         std::vector<int> dims;
+        std::vector<int> strides;
+
+        TensorWrapper(TfLiteTensor* tensor): 
+            data(tensor->type == kTfLiteFloat32 ? tensor->data.f : nullptr), raw(tensor->data.raw), 
+            bytes(tensor->bytes), type(tensor->type), count(1),
+            dims(tensor->dims->data, tensor->dims->data + tensor->dims->size), strides(tensor->dims->size, 1) {
+            quantization.scale = tensor->params.scale;
+            quantization.zeroPoint = tensor->params.zero_point;
+            for (int i = (int)dims.size() - 2; i >= 0; --i) {
+                strides[i] = strides[i + 1] * dims[i + 1];
+            }
+            for (int dim : dims) count *= dim;
+        }
+    };
+
+    /*
+    A read-only view over the data of a tflite tensor (nothing is copied).
+    The view is valid until the tensors of the model are re-allocated.
+    Attributes:
+        data: a pointer to tensor data
+        size: number of elements
+        dims: shape of data tensor (rank elements)
+        strides: number of elements between two consecutive indices of each dimension
+    */
+    template <class T>
+    struct TensorView {
+        const T* data;
+        size_t size;
+        const int* dims;
+        const int* strides;
+        int rank;
+
+        TensorView(): data(nullptr), size(0), dims(nullptr), strides(nullptr), rank(0) {}
+        TensorView(const T* t_data, size_t t_size, const std::vector<int>& t_dims, const std::vector<int>& t_strides):
+            data(t_data), size(t_size), dims(t_dims.data()), strides(t_strides.data()), rank((int)t_dims.size()) {}
+
+        bool empty() const { return size == 0; }
+        const T* begin() const { return data; }
+        const T* end() const { return data + size; }
+        const T& operator[](size_t i) const { return data[i]; }
+
+        /*
+        View of item i along the first dimension (e.g. one item of a batch)
+        */
+        TensorView slice(int i) const {
+            TensorView view;
+            if (rank < 1 || i < 0 || i >= dims[0]) return view;
+
+            view.data = data + (size_t)i * strides[0];
+            view.size = strides[0];
+            view.dims = dims + 1;
+            view.strides = strides + 1;
+            view.rank = rank - 1;
+            return view;
+        }
+
+        /*
+        Access element by its full index, e.g. view.at(0, y, x, c)
+        */
+        template <class... Index>
+        const T& at(Index... index) const {
+            const int idx[] = {index...};
+            size_t offset = 0;
+            for (int i = 0; i < (int)sizeof...(Index); ++i) {
+                offset += (size_t)idx[i] * strides[i];
+            }
+            return data[offset];
+        }
+    };
+
+    /*
+    A read-only view over a uint8/int8 tensor with its quantization params.
+    Values are dequantized only when accessed with operator[].
+    */
+    template <class T>
+    struct QuantizedView {
+        TensorView<T> values;
+        QuantizationParams params;
 
-        TensorWrapper(float* t_data, size_t t_bytes, int* t_dims, int t_dimSize): 
-            data(t_data), bytes(t_bytes), dims(t_dims, t_dims + t_dimSize) {}
+        bool empty() const { return values.empty(); }
+        float operator[](size_t i) const { return params.dequantize(values[i]); }
+    };
+
+    /*
+    Precomputed bilinear sampling positions to resize an image to an input tensor.
+    Attributes:
+        x0, x1: byte offsets of the left/right source pixels of each output column
+        y0, y1: source rows of each output row
+        wx, wy: interpolation weights of x1 and y1
+    */
+    struct ResizeTable {
+        cv::Size srcSize;
+        cv::Size dstSize;
+        int channels = 0;
+        std::vector<int> x0, x1, y0, y1;
+        std::vector<float> wx, wy;
     };
 
     /*
@@ -39,10 +156,13 @@ namespace my {
         public:
             /*
             Constructor from a .tflite file
+            (Note: the file is loaded once per process and shared, see ModelRegistry)
             Parameters:
                 modelPath: path to .tflite
+                options: delegate, threads and allocation of the interpreter 
+                         (Auto attributes are tuned on first use, see InterpreterTuner)
             */
-            ModelLoader(std::string modelPath);
+            ModelLoader(std::string modelPath, const InterpreterOptions& options = InterpreterOptions());
             ModelLoader(const ModelLoader& other) = delete;
             ModelLoader& operator=(const ModelLoader& other) = delete;
             virtual ~ModelLoader() = default;
@@ -55,8 +175,14 @@ namespace my {
             */
             std::vector<int> getInputShape(int index = 0) const;
 
+            /*
+            Get width and height of image input tensor at index (NHWC), without copying its shape
+            */
+            cv::Size getInputImageSize(int index = 0) const;
+
             /*
             Get the pointer to the data of input tensor at index.
+            Return nullptr if the input is not float32 (see getInputType).
             (Note: A model can have multiple inputs)
             Parameters:
                 index: index of input tensor
@@ -86,6 +212,7 @@ namespace my {
 
             /*
             Get the pointer to the data of output tensor at index.
+            Outputs that are not float32 are dequantized first.
             (Note: A model can have multiple outputs)
             Parameters:
                 index: index of output tensor
@@ -105,6 +232,38 @@ namespace my {
             */
             int getNumberOfOutputs() const;
 
+            /*
+            Get the options the interpreter was built with (Auto attributes resolved)
+            */
+            InterpreterOptions getInterpreterOptions() const;
+
+            /*
+            Get element type and quantization params of input/output tensor at index
+            */
+            TfLiteType getInputType(int index = 0) const;
+            TfLiteType getOutputType(int index = 0) const;
+            QuantizationParams getInputQuantization(int index = 0) const;
+            QuantizationParams getOutputQuantization(int index = 0) const;
+
+            /*
+            A view over the quantized values of output at index, without dequantization.
+            Return an empty view if the output type is not T (uint8_t or int8_t).
+            */
+            template <class T>
+            QuantizedView<T> getQuantizedOutputView(int index = 0) const {
+                QuantizedView<T> view;
+                if (!isIndexValid(index, 'o')) return view;
+
+                const auto& output = m_outputs[index];
+                bool isSameType = (std::is_same<T, uint8_t>::value && output.type == kTfLiteUInt8) ||
+                                  (std::is_same<T, int8_t>::value && output.type == kTfLiteInt8);
+                if (isSameType) {
+                    view.values = TensorView<T>(static_cast<const T*>(output.raw), output.count, output.dims, output.strides);
+                    view.params = output.quantization;
+                }
+                return view;
+            }
+
             /*
             Load image (BGR format) to model at index 
             (Note: Only support image of type CV_8UC3 and CV_8UC4)
@@ -112,10 +271,69 @@ namespace my {
             virtual void loadImageToInput(const cv::Mat& inputImage, int index = 0);
 
             /*
-            Load byte data to model at index
+            Load image (BGR format) to ONE item of a batched input at index
+            (Note: the whole batch must be loaded before running inference)
+            Parameters:
+                batch: position of the image in the batch
+                mirror: flip the image horizontally
+            */
+            void loadImageToBatch(const cv::Mat& inputImage, int batch, bool mirror = false, int index = 0);
+
+            /*
+            Crop roi from image (BGR format) and load it to model at index in one pass
+            (no cropped or resized copy): the Roi is rotated by roi.angle degrees around its center
+            and sampled bilinearly straight into the input tensor.
+            Parts of the Roi outside the image are black, as in FaceDetection::cropFrame.
+            (Note: Only support image of type CV_8UC3 and CV_8UC4)
+            */
+            void loadRoiToInput(const cv::Mat& inputImage, const cv::RotatedRect& roi, int index = 0);
+            void loadRoiToInput(const cv::Mat& inputImage, const cv::Rect& roi, int index = 0);
+
+            /*
+            Same as loadRoiToInput, for ONE item of a batched input at index (see loadImageToBatch)
+            */
+            void loadRoiToBatch(const cv::Mat& inputImage, const cv::RotatedRect& roi, int batch, 
+                                bool mirror = false, int index = 0);
+            void loadRoiToBatch(const cv::Mat& inputImage, const cv::Rect& roi, int batch, 
+                                bool mirror = false, int index = 0);
+
+            /*
+            Axis-aligned Roi as a cv::RotatedRect (angle 0)
+            */
+            static cv::RotatedRect toRotatedRect(const cv::Rect& roi);
+
+            /*
+            Resize input tensor at index (e.g. to change its batch size), 
+            then re-allocate all tensors.
+            (Note: all data pointers and views got before are invalidated)
+            */
+            void resizeInput(const std::vector<int>& dims, int index = 0);
+
+            /*
+            Change the number of intra-op threads between two inferences.
+            With XNNPACK, the delegate owns its threads: the interpreter is rebuilt (input shapes are kept).
+            (Note: all inputs must be loaded again, data pointers and views got before are invalidated)
+            */
+            virtual void setNumThreads(int numThreads);
+
+            /*
+            Set the layout of the images given to loadImageToInput/loadImageToBatch/loadRoiTo* (default PixelFormat::BGR).
+            YUV images are converted to RGB only at the pixels sampled into the input tensor.
+            */
+            virtual void setPixelFormat(PixelFormat format);
+            PixelFormat getPixelFormat() const;
+
+            /*
+            Load byte data to model at index (getInputSize(index) bytes, in the element type of the input)
             */
             virtual void loadBytesToInput(const void* data, int index = 0);
 
+            /*
+            Same as loadBytesToInput() with the size of data checked:
+            bytes must be getInputSize(index), otherwise nothing is loaded.
+            */
+            void loadRawToInput(const void* data, size_t bytes, int index = 0);
+
             /*
             Run inference on the inputs.
             Can only run when all input tensors have been loaded.
@@ -128,13 +346,20 @@ namespace my {
             */
             virtual std::vector<float> loadOutput(int index = 0) const;
 
+            /*
+            A read-only view over output data at index, without copy
+            (quantized and fp16 outputs are dequantized once per inference, on first access).
+            Prefer this to loadOutput() in per-frame code.
+            */
+            virtual TensorView<float> getOutputView(int index = 0) const;
+
 
         private:
             /*
             Constructor helper functions
             */
             void loadModel(const char* modelPath);
-            void buildInterpreter(int numThreads = -1);
+            void buildInterpreter(const InterpreterOptions& options);
             void allocateTensors();           
             void fillInputTensors();
             void fillOutputTensors();
@@ -155,14 +380,32 @@ namespace my {
             void inputChecker();
 
             /*
-            Convert image to float and resize to getInputShape(idx)
+            Resize, convert BGR(A) to RGB and normalize image in one pass,
+            writing straight into the input tensor at idx (quantized or converted to its type)
+            */
+            void preprocessImage(const cv::Mat& in, int idx, int batch = 0, bool mirror = false);
+
+            /*
+            Sample the (rotated) roi of image to the input tensor at idx, with the same conversions
+            as preprocessImage
             */
-            cv::Mat preprocessImage(const cv::Mat& in, int idx) const;
+            void preprocessRoi(const cv::Mat& in, const cv::RotatedRect& roi, int idx, int batch = 0, bool mirror = false);
 
             /*
-            Convert image of type CV_8UC3 or CV_8UC4 to RGB format
+            Get number of channels of image of type CV_8UC3 or CV_8UC4 (1 for a YUV image: pixels are sampled by index).
+            Exit if the image does not match the pixel format.
             */
-            cv::Mat convertToRGB(const cv::Mat& in) const;
+            int getImageChannels(const cv::Mat& in) const;
+
+            /*
+            Update the sampling table of input idx if the image size changed
+            */
+            const ResizeTable& getResizeTable(const cv::Size& srcSize, int channels, int idx);
+
+            /*
+            Convert output idx to float in m_dequantizedOutputs if not done since the last inference
+            */
+            const float* dequantizeOutput(int idx) const;
 
 
         private:
@@ -177,9 +420,22 @@ namespace my {
             std::vector<TensorWrapper> m_outputs;
 
             /*
-            TFLite core
+            TFLite core (shared with all loaders of the same file, see ModelRegistry)
+            */
+            std::shared_ptr<tflite::FlatBufferModel> m_model;
+
+            /*
+            Interpreter settings, the delegate must outlive the interpreter 
+            and the weights cache must outlive the delegate
+            */
+            InterpreterOptions m_options;
+            std::shared_ptr<SharedWeightsCache> m_weightsCache;
+            std::unique_ptr<TfLiteDelegate, void(*)(TfLiteDelegate*)> m_delegate;
+
+            /*
+            Layout of the input images
             */
-            std::unique_ptr<tflite::FlatBufferModel> m_model;
+            PixelFormat m_pixelFormat;
 
             /*
             TFLite core
@@ -190,6 +446,25 @@ namespace my {
             Tracking inputs loaded
             */
             std::vector<bool> m_inputLoads;
+
+            /*
+            Cached sampling tables for each input
+            */
+            std::vector<ResizeTable> m_resizeTables;
+
+            /*
+            Float copies of the outputs that are not float32, refreshed lazily after each inference
+            (guarded by m_dequantizeMutex, as concurrent const getters may fill them)
+            */
+            mutable std::vector<std::vector<float>> m_dequantizedOutputs;
+            mutable std::vector<bool> m_isDequantized;
+            mutable std::mutex m_dequantizeMutex;
+
+            /*
+            Metrics stage ids ("<model>.preprocess" and "<model>.invoke")
+            */
+            int m_preprocessStage;
+            int m_invokeStage;
     };
 };
 
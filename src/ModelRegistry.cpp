@@ -0,0 +1,87 @@
+#include "ModelRegistry.hpp"
+
+#include <filesystem>
+#include <system_error>
+
+/*
+Helper function
+*/
+std::string normalizePath(const std::string& path) {
+    std::error_code error;
+    auto canonical = std::filesystem::weakly_canonical(path, error);
+    return error ? path : canonical.string();
+}
+
+
+my::ModelRegistry::ModelRegistry():
+    m_totalLoads(0),
+    m_sharedAcquisitions(0),
+    m_savedBytes(0)
+{}
+
+
+my::ModelRegistry& my::ModelRegistry::getInstance() {
+    static ModelRegistry registry;
+    return registry;
+}
+
+
+std::shared_ptr<tflite::FlatBufferModel> my::ModelRegistry::acquire(const std::string& modelPath) {
+    auto key = normalizePath(modelPath);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+    if (it != m_entries.end()) {
+        auto model = it->second.model.lock();
+        if (model) {
+            m_sharedAcquisitions++;
+            m_savedBytes += it->second.bytes;
+            return model;
+        }
+    }
+
+    /*
+    BuildFromFile memory-maps the file when the platform supports it
+    */
+    std::shared_ptr<tflite::FlatBufferModel> model = 
+        tflite::FlatBufferModel::BuildFromFile(key.c_str());
+    if (model == nullptr) return nullptr;
+
+    std::error_code error;
+    auto bytes = std::filesystem::file_size(key, error);
+
+    m_entries[key].model = model;
+    m_entries[key].bytes = error ? 0 : (size_t)bytes;
+    m_totalLoads++;
+    return model;
+}
+
+
+std::shared_ptr<my::SharedWeightsCache> my::ModelRegistry::acquireWeightsCache(const std::string& modelPath) {
+    auto key = normalizePath(modelPath);
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& entry = m_entries[key];
+    auto cache = entry.weightsCache.lock();
+    if (cache == nullptr) {
+        cache = std::make_shared<SharedWeightsCache>();
+        entry.weightsCache = cache;
+    }
+    return cache;
+}
+
+
+my::ModelRegistryStats my::ModelRegistry::getStats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    ModelRegistryStats stats = {0, 0, m_totalLoads, m_sharedAcquisitions, 0, m_savedBytes};
+    for (auto& entry: m_entries) {
+        long users = entry.second.model.use_count();
+        if (users == 0) continue;
+
+        stats.loadedModels++;
+        stats.activeReferences += users;
+        stats.loadedBytes += entry.second.bytes;
+    }
+    return stats;
+}
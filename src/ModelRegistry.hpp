@@ -0,0 +1,97 @@
+#ifndef MODELREGISTRY_H
+#define MODELREGISTRY_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "tensorflow/lite/model.h"
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+
+namespace my {
+
+    /*
+    Sharing statistics of the ModelRegistry.
+    Attributes:
+        loadedModels: number of models currently in memory
+        activeReferences: number of interpreters/users holding a model
+        totalLoads: number of times a file was actually loaded
+        sharedAcquisitions: number of times an already loaded model was handed out
+        loadedBytes: size of the models currently in memory
+        savedBytes: size that would have been loaded again without sharing
+    */
+    struct ModelRegistryStats {
+        int loadedModels;
+        int activeReferences;
+        int totalLoads;
+        int sharedAcquisitions;
+        size_t loadedBytes;
+        size_t savedBytes;
+    };
+
+    /*
+    XNNPACK weights of one model, packed once and shared by all its delegates.
+    Delegates are created under the mutex: packing inserts into the cache.
+    The cache is finalized once, after the first delegate packed the weights.
+    */
+    struct SharedWeightsCache {
+        TfLiteXNNPackDelegateWeightsCache* cache;
+        bool isFinalized;
+        std::mutex mutex;
+
+        SharedWeightsCache(): cache(TfLiteXNNPackDelegateWeightsCacheCreate()), isFinalized(false) {}
+        ~SharedWeightsCache() { TfLiteXNNPackDelegateWeightsCacheDelete(cache); }
+    };
+
+    /*
+    A process-wide registry that loads (memory-maps) each .tflite file once 
+    and shares the FlatBufferModel (and its packed XNNPACK weights) between all interpreters built from it.
+    A model is released when its last user is destroyed.
+    This class is thread-safe and non-copyable.
+    */
+    class ModelRegistry {
+        public:
+            static ModelRegistry& getInstance();
+
+            ModelRegistry(const ModelRegistry& other) = delete;
+            ModelRegistry& operator=(const ModelRegistry& other) = delete;
+
+            /*
+            Get the model at modelPath, loading it if no one holds it yet.
+            Return nullptr if the file cannot be loaded.
+            */
+            std::shared_ptr<tflite::FlatBufferModel> acquire(const std::string& modelPath);
+
+            /*
+            Get the XNNPACK weights cache of the model at modelPath, creating it if no one holds it yet
+            */
+            std::shared_ptr<SharedWeightsCache> acquireWeightsCache(const std::string& modelPath);
+
+            /*
+            Get sharing statistics
+            */
+            ModelRegistryStats getStats() const;
+
+
+        private:
+            ModelRegistry();
+
+            struct Entry {
+                std::weak_ptr<tflite::FlatBufferModel> model;
+                std::weak_ptr<SharedWeightsCache> weightsCache;
+                size_t bytes = 0;
+            };
+
+
+        private:
+            mutable std::mutex m_mutex;
+            std::map<std::string, Entry> m_entries;
+
+            int m_totalLoads;
+            int m_sharedAcquisitions;
+            size_t m_savedBytes;
+    };
+}
+
+#endif // MODELREGISTRY_H
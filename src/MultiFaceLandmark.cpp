@@ -0,0 +1,52 @@
+#include "MultiFaceLandmark.hpp"
+
+
+my::MultiFaceLandmark::MultiFaceLandmark(std::string modelPath, int maxFaces, const PipelineOptions& options):
+    FaceDetection(modelPath, options.detection, options.detectorRange),
+    m_threadPool(&ThreadPool::getDefault())
+{
+    FaceDetection::setMaxFaces(maxFaces);
+
+    /*
+    Load all workers up front, so no model is loaded during inference
+    */
+    for (int i = 0; i < FaceDetection::getMaxFaces(); ++i) {
+        m_workers.emplace_back(new FaceMeshWorker(modelPath, options));
+    }
+}
+
+
+void my::MultiFaceLandmark::runInference() {
+    FaceDetection::runInference();
+    m_rois = FaceDetection::getFaceRois();
+    auto frame = FaceDetection::getOriginalImage();
+
+    int numFaces = std::min(m_rois.size(), m_workers.size());
+    m_results.resize(numFaces);
+
+    /*
+    The first face runs on the calling thread
+    */
+    auto faceTask = [this, &frame](int i) {
+        m_workers[i]->process(frame, m_rois[i], m_results[i]);
+    };
+    m_threadPool->parallelFor(numFaces, faceTask);
+}
+
+
+const std::vector<my::FaceResult>& my::MultiFaceLandmark::getFaceResults() const {
+    return m_results;
+}
+
+
+void my::MultiFaceLandmark::setThreadPool(ThreadPool* pool) {
+    m_threadPool = pool;
+}
+
+
+void my::MultiFaceLandmark::setPixelFormat(PixelFormat format) {
+    FaceDetection::setPixelFormat(format);
+    for (auto& worker: m_workers) {
+        worker->setPixelFormat(format);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef MULTIFACELANDMARK_H
+#define MULTIFACELANDMARK_H
+
+#include "FaceDetection.hpp"
+#include "FaceMeshWorker.hpp"
+#include "ThreadPool.hpp"
+
+namespace my {
+
+    /*
+    A model wrapper to get face and iris landmarks of SEVERAL faces.
+    It includes the detection phase, then each face is processed by its own
+    FaceMeshWorker in parallel.
+    This class is non-copyable.
+    */
+    class MultiFaceLandmark : public my::FaceDetection {
+        public:
+            /*
+            Users MUST provide the FOLDER contain ALL the face_detection_short.tflite, 
+            face_landmark.tflite and iris_landmark.tflite 
+            maxFaces: maximum number of faces processed per frame
+            options: interpreter settings of each stage
+            */
+            MultiFaceLandmark(std::string modelPath, int maxFaces = 4, const PipelineOptions& options = PipelineOptions());
+            virtual ~MultiFaceLandmark() = default;
+
+            /*
+            Override function from FaceDetection
+            */
+            virtual void runInference();
+
+            /*
+            Get the results of all faces in the last frame, sorted by detection confidence.
+            */
+            const std::vector<FaceResult>& getFaceResults() const;
+
+            /*
+            Set the worker pool processing the faces in parallel 
+            (default: ThreadPool::getDefault()). The pool must outlive this object.
+            */
+            void setThreadPool(ThreadPool* pool);
+
+            /*
+            Override function from ModelLoader: the detector and every worker read frames of format
+            */
+            virtual void setPixelFormat(PixelFormat format);
+
+
+        private:
+            std::vector<std::unique_ptr<FaceMeshWorker>> m_workers;
+            std::vector<FaceResult> m_results;
+            std::vector<cv::Rect> m_rois;
+            ThreadPool* m_threadPool;
+    };
+}
+
+#endif // MULTIFACELANDMARK_H
@@ -0,0 +1,89 @@
+#include "PipelineExecutor.hpp"
+
+
+my::PipelineExecutor::PipelineExecutor(std::string modelPath, int queueCapacity, const PipelineOptions& options):
+    m_detector(modelPath, options.detection, options.detectorRange),
+    m_meshWorker(modelPath, options),
+    m_detectionQueue(queueCapacity),
+    m_landmarkQueue(queueCapacity),
+    m_irisQueue(queueCapacity)
+{
+    m_detectionThread = std::thread([this]() {runDetectionStage();});
+    m_landmarkThread = std::thread([this]() {runLandmarkStage();});
+    m_irisThread = std::thread([this]() {runIrisStage();});
+}
+
+
+my::PipelineExecutor::~PipelineExecutor() {
+    /*
+    Each stage closes the next queue once its own input is drained
+    */
+    m_detectionQueue.close();
+    m_detectionThread.join();
+    m_landmarkThread.join();
+    m_irisThread.join();
+}
+
+
+std::future<my::FaceResult> my::PipelineExecutor::submit(const cv::Mat& frame) {
+    JobPtr job(new FrameJob());
+    job->frame = frame;
+    auto future = job->promise.get_future();
+
+    m_detectionQueue.push(std::move(job));
+    return future;
+}
+
+
+void my::PipelineExecutor::submit(const cv::Mat& frame, Callback callback) {
+    JobPtr job(new FrameJob());
+    job->frame = frame;
+    job->callback = std::move(callback);
+
+    m_detectionQueue.push(std::move(job));
+}
+
+void my::PipelineExecutor::setPixelFormat(PixelFormat format) {
+    m_detector.setPixelFormat(format);
+    m_meshWorker.setPixelFormat(format);
+}
+
+//-------------------Private methods start here-------------------
+
+void my::PipelineExecutor::runDetectionStage() {
+    JobPtr job;
+    while (m_detectionQueue.pop(job)) {
+        m_detector.loadImageToInput(job->frame);
+        m_detector.runInference();
+        job->result.roi = m_detector.getFaceRoi();
+
+        m_landmarkQueue.push(std::move(job));
+    }
+    m_landmarkQueue.close();
+}
+
+
+void my::PipelineExecutor::runLandmarkStage() {
+    JobPtr job;
+    while (m_landmarkQueue.pop(job)) {
+        m_meshWorker.runFaceLandmark(job->frame, job->result.roi, job->result);
+
+        m_irisQueue.push(std::move(job));
+    }
+    m_irisQueue.close();
+}
+
+
+void my::PipelineExecutor::runIrisStage() {
+    JobPtr job;
+    while (m_irisQueue.pop(job)) {
+        m_meshWorker.runIrisLandmark(job->frame, job->result);
+
+        if (job->callback) {
+            job->callback(job->result);
+        }
+        else {
+            job->promise.set_value(std::move(job->result));
+        }
+    }
+}
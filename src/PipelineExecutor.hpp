@@ -0,0 +1,92 @@
+#ifndef PIPELINEEXECUTOR_H
+#define PIPELINEEXECUTOR_H
+
+#include <functional>
+#include <future>
+#include <thread>
+
+#include "FaceDetection.hpp"
+#include "FaceMeshWorker.hpp"
+#include "BoundedQueue.hpp"
+
+namespace my {
+
+    /*
+    Run face detection, face landmark and iris landmark as a pipeline:
+    each stage has its own worker thread and interpreters, and stages are connected
+    by bounded queues, so the detection of frame N+1 overlaps the landmarks of frame N.
+    Results are delivered in submission order.
+    This class is non-copyable.
+    */
+    class PipelineExecutor {
+        public:
+            typedef std::function<void(const FaceResult&)> Callback;
+
+            /*
+            Users MUST provide the FOLDER contain ALL the face_detection_short.tflite, 
+            face_landmark.tflite and iris_landmark.tflite 
+            queueCapacity: maximum number of frames waiting before each stage
+            options: interpreter settings of each stage and the face detector to load
+            */
+            PipelineExecutor(std::string modelPath, int queueCapacity = 2, const PipelineOptions& options = PipelineOptions());
+            PipelineExecutor(const PipelineExecutor& other) = delete;
+            PipelineExecutor& operator=(const PipelineExecutor& other) = delete;
+
+            /*
+            Finish all submitted frames, then stop the workers.
+            */
+            ~PipelineExecutor();
+
+            /*
+            Set the layout of the submitted frames (default PixelFormat::BGR).
+            Call it while no frame is in flight.
+            */
+            void setPixelFormat(PixelFormat format);
+
+            /*
+            Submit a frame (see setPixelFormat), blocking while the first queue is full.
+            (Note: the frame data is NOT copied, do not modify it until its result is ready)
+            */
+            std::future<FaceResult> submit(const cv::Mat& frame);
+
+            /*
+            Same as submit(frame), the callback is called on the last stage's worker.
+            */
+            void submit(const cv::Mat& frame, Callback callback);
+
+
+        private:
+            /*
+            A frame travelling through the stages
+            */
+            struct FrameJob {
+                cv::Mat frame;
+                FaceResult result;
+                std::promise<FaceResult> promise;
+                Callback callback;
+            };
+            typedef std::unique_ptr<FrameJob> JobPtr;
+
+            /*
+            Stage loops
+            */
+            void runDetectionStage();
+            void runLandmarkStage();
+            void runIrisStage();
+
+
+        private:
+            FaceDetection m_detector;
+            FaceMeshWorker m_meshWorker;
+
+            BoundedQueue<JobPtr> m_detectionQueue;
+            BoundedQueue<JobPtr> m_landmarkQueue;
+            BoundedQueue<JobPtr> m_irisQueue;
+
+            std::thread m_detectionThread;
+            std::thread m_landmarkThread;
+            std::thread m_irisThread;
+    };
+}
+
+#endif // PIPELINEEXECUTOR_H
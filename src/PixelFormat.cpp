@@ -0,0 +1,104 @@
+#include "PixelFormat.hpp"
+#include "opencv2/imgproc.hpp"
+
+
+bool my::isImageValid(const cv::Mat& image, PixelFormat format) {
+    switch (format) {
+        case PixelFormat::BGR:
+            return image.type() == CV_8UC3 || image.type() == CV_8UC4;
+        case PixelFormat::NV12:
+            return image.type() == CV_8UC1 && image.rows % 3 == 0 && image.cols % 2 == 0;
+        case PixelFormat::I420:
+            /*
+            The U and V planes are packed at half width right after the Y plane
+            */
+            return image.type() == CV_8UC1 && image.rows % 3 == 0 && image.cols % 2 == 0 && image.isContinuous();
+        case PixelFormat::YUYV:
+            return image.type() == CV_8UC2 && image.cols % 2 == 0;
+    }
+    return false;
+}
+
+
+cv::Size my::getImageSize(const cv::Mat& image, PixelFormat format) {
+    if (format == PixelFormat::NV12 || format == PixelFormat::I420)
+        return cv::Size(image.cols, image.rows * 2 / 3);
+
+    return image.size();
+}
+
+
+my::YuvPlanes my::getYuvPlanes(const cv::Mat& image, PixelFormat format) {
+    YuvPlanes planes;
+    planes.size = getImageSize(image, format);
+    planes.y = image.ptr<uchar>(0);
+    planes.yStep = image.step;
+
+    switch (format) {
+        case PixelFormat::NV12:
+            planes.u = image.ptr<uchar>(planes.size.height);
+            planes.v = planes.u + 1;
+            planes.uvStep = image.step;
+            planes.uvPixelStep = 2;
+            break;
+        case PixelFormat::I420: {
+            size_t chromaStep = planes.size.width / 2;
+            planes.u = image.ptr<uchar>(planes.size.height);
+            planes.v = planes.u + chromaStep * (planes.size.height / 2);
+            planes.uvStep = chromaStep;
+            break;
+        }
+        case PixelFormat::YUYV:
+            planes.u = planes.y + 1;
+            planes.v = planes.y + 3;
+            planes.uvStep = image.step;
+            planes.yPixelStep = 2;
+            planes.uvPixelStep = 4;
+            planes.chromaShiftY = 0;
+            break;
+        default:
+            break;
+    }
+    return planes;
+}
+
+
+void my::cropToBGR(const cv::Mat& image, PixelFormat format, const cv::Rect& roi, cv::Mat& bgr) {
+    auto planes = getYuvPlanes(image, format);
+    bgr.create(roi.size(), CV_8UC3);
+
+    for (int r = 0; r < roi.height; ++r) {
+        int y = roi.y + r;
+        uchar* out = bgr.ptr<uchar>(r);
+
+        for (int c = 0; c < roi.width; ++c, out += 3) {
+            int x = roi.x + c;
+            if (x < 0 || y < 0 || x >= planes.size.width || y >= planes.size.height) {
+                out[0] = out[1] = out[2] = 0;
+                continue;
+            }
+
+            float rgb[3];
+            yuvToRgb(planes.getY(x, y), planes.getU(x, y), planes.getV(x, y), rgb);
+            out[0] = (uchar)(rgb[2] + 0.5f);
+            out[1] = (uchar)(rgb[1] + 0.5f);
+            out[2] = (uchar)(rgb[0] + 0.5f);
+        }
+    }
+}
+
+
+void my::convertToGray(const cv::Mat& image, PixelFormat format, cv::Mat& gray) {
+    switch (format) {
+        case PixelFormat::BGR:
+            cv::cvtColor(image, gray, image.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+            break;
+        case PixelFormat::NV12:
+        case PixelFormat::I420:
+            gray = image.rowRange(0, getImageSize(image, format).height);
+            break;
+        case PixelFormat::YUYV:
+            cv::cvtColor(image, gray, cv::COLOR_YUV2GRAY_YUYV);
+            break;
+    }
+}
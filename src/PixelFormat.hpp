@@ -0,0 +1,85 @@
+#ifndef PIXELFORMAT_H
+#define PIXELFORMAT_H
+
+#include "opencv2/core.hpp"
+
+#include <algorithm>
+
+namespace my {
+
+    /*
+    Layout of the frames given to the pipeline (see ModelLoader::setPixelFormat):
+        BGR: CV_8UC3 or CV_8UC4 (BGRA)
+        NV12: CV_8UC1 of height * 3 / 2 rows, the Y plane then interleaved U, V at half resolution
+        I420: CV_8UC1 of height * 3 / 2 rows, the Y plane then the U and V planes at half resolution
+        YUYV: CV_8UC2 (YUY2), Y0 U Y1 V for each pair of pixels
+    YUV frames are BT.601 limited range, as cv::COLOR_YUV2BGR_NV12 expects.
+    */
+    enum class PixelFormat {
+        BGR,
+        NV12,
+        I420,
+        YUYV
+    };
+
+    /*
+    Byte layout of a YUV frame:
+        Y of pixel (x, y) = y[y * yStep + x * yPixelStep]
+        U of pixel (x, y) = u[(y >> chromaShiftY) * uvStep + (x >> 1) * uvPixelStep], same for V
+    */
+    struct YuvPlanes {
+        const uchar* y = nullptr;
+        const uchar* u = nullptr;
+        const uchar* v = nullptr;
+        size_t yStep = 0;
+        size_t uvStep = 0;
+        int yPixelStep = 1;
+        int uvPixelStep = 1;
+        int chromaShiftY = 1;
+        cv::Size size;
+
+        uchar getY(int x, int row) const { return y[row * yStep + x * yPixelStep]; }
+        uchar getU(int x, int row) const { return u[(row >> chromaShiftY) * uvStep + (x >> 1) * uvPixelStep]; }
+        uchar getV(int x, int row) const { return v[(row >> chromaShiftY) * uvStep + (x >> 1) * uvPixelStep]; }
+    };
+
+    /*
+    Check that image has the type and shape of format (even sizes for YUV, continuous I420)
+    */
+    bool isImageValid(const cv::Mat& image, PixelFormat format);
+
+    /*
+    Width and height in pixels of an image of format (the Mat of a 4:2:0 frame has 1.5x more rows)
+    */
+    cv::Size getImageSize(const cv::Mat& image, PixelFormat format);
+
+    /*
+    Planes of a YUV image (image must be valid, format must not be BGR)
+    */
+    YuvPlanes getYuvPlanes(const cv::Mat& image, PixelFormat format);
+
+    /*
+    Convert a limited range YUV value to R, G, B in [0..255] (not rounded)
+    */
+    inline void yuvToRgb(float y, float u, float v, float* rgb) {
+        float luma = 1.164f * (y - 16.f);
+        u -= 128.f;
+        v -= 128.f;
+        rgb[0] = std::min(std::max(luma + 1.596f * v, 0.f), 255.f);
+        rgb[1] = std::min(std::max(luma - 0.813f * v - 0.391f * u, 0.f), 255.f);
+        rgb[2] = std::min(std::max(luma + 2.018f * u, 0.f), 255.f);
+    }
+
+    /*
+    Convert the roi of image to a BGR CV_8UC3 patch (padding with black), only the pixels of roi are converted.
+    The buffer of bgr is reused when it already has the Roi size.
+    */
+    void cropToBGR(const cv::Mat& image, PixelFormat format, const cv::Rect& roi, cv::Mat& bgr);
+
+    /*
+    Gray image of a frame: the Y plane of a 4:2:0 frame is shared, not copied
+    */
+    void convertToGray(const cv::Mat& image, PixelFormat format, cv::Mat& gray);
+}
+
+#endif // PIXELFORMAT_H
@@ -0,0 +1,223 @@
+#include "QualityGovernor.hpp"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <time.h>
+#endif
+
+
+/*
+Helper functions
+*/
+void updateMovingAverage(float& average, float sample, float smoothing) {
+    if (sample <= 0.f) return;
+    average = average > 0.f ? average + smoothing * (sample - average) : sample;
+}
+
+
+double getProcessCpuMs() {
+#if defined(_WIN32)
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    auto toMs = [](const FILETIME& time) {
+        return (((uint64_t)time.dwHighDateTime << 32) | time.dwLowDateTime) / 1e4;
+    };
+    return toMs(kernel) + toMs(user);
+#else
+    timespec time;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time);
+    return time.tv_sec * 1e3 + time.tv_nsec / 1e6;
+#endif
+}
+
+
+my::QualityGovernor::QualityGovernor(IrisLandmark& pipeline, const GovernorOptions& options):
+    m_pipeline(pipeline),
+    m_options(options),
+    m_level(-1),
+    m_framesSinceChange(0),
+    m_frameMs(0.f),
+    m_appliedThreads(0),
+    m_pendingThreads(0),
+    m_lastCpuMs(0.)
+{
+    m_options.maxDetectInterval = std::max(m_options.maxDetectInterval, 1);
+    m_options.maxIrisInterval = std::max(m_options.maxIrisInterval, 1);
+    m_options.holdFrames = std::max(m_options.holdFrames, 1);
+
+    int maxThreads = m_options.maxThreads > 0 ? m_options.maxThreads :
+        m_pipeline.getInterpreterOptions().numThreads;
+    buildLevels(maxThreads);
+    m_levelCosts.resize(m_levels.size(), 0.f);
+    applyLevel(0);
+    applyPendingSettings();
+    m_lastCpuMs = getProcessCpuMs();
+}
+
+
+void my::QualityGovernor::process(const cv::Mat& frame) {
+    applyPendingSettings();
+    m_pipeline.loadImageToInput(frame);
+    m_pipeline.runInference();
+    update();
+}
+
+
+void my::QualityGovernor::update() {
+    auto times = m_pipeline.getLastStageTimes();
+    updateMovingAverage(m_stageCosts.detectionMs, times.detectionMs, m_options.smoothing);
+    updateMovingAverage(m_stageCosts.landmarkMs, times.landmarkMs, m_options.smoothing);
+    updateMovingAverage(m_stageCosts.irisMs, times.irisMs, m_options.smoothing);
+
+    float frameMs = times.detectionMs + times.landmarkMs + times.irisMs;
+    if (m_options.budgetType == BudgetType::Cpu) {
+        double cpuMs = getProcessCpuMs();
+        frameMs = (float)(cpuMs - m_lastCpuMs);
+        m_lastCpuMs = cpuMs;
+    }
+    updateMovingAverage(m_frameMs, frameMs, m_options.smoothing);
+    updateMovingAverage(m_levelCosts[m_level], frameMs, m_options.smoothing);
+
+    if (++m_framesSinceChange < m_options.holdFrames)
+        return;
+
+    /*
+    Over budget: step down to the first level predicted under budget (at least one level).
+    Under budget: step up one level if it is predicted well under budget.
+    */
+    int last = (int)m_levels.size() - 1;
+    int level = m_level;
+    if (m_frameMs > m_options.budgetMs) {
+        level = std::min(m_level + 1, last);
+        while (level < last && predictCost(m_levels[level]) > m_options.budgetMs) level++;
+    }
+    else if (m_level > 0 && predictCost(m_levels[m_level - 1]) <= m_options.upgradeMargin * m_options.budgetMs) {
+        level = m_level - 1;
+    }
+
+    if (level != m_level)
+        applyLevel(level);
+}
+
+
+void my::QualityGovernor::applyPendingSettings() {
+    if (m_pendingThreads < 1) return;
+
+    m_pipeline.setNumThreads(m_pendingThreads);
+    m_appliedThreads = m_pendingThreads;
+    m_pendingThreads = 0;
+
+    /*
+    The rebuild is not part of the cost of the frame
+    */
+    m_lastCpuMs = getProcessCpuMs();
+}
+
+
+my::GovernorDecision my::QualityGovernor::getDecision() const {
+    auto decision = m_levels[m_level];
+    decision.predictedMs = predictCost(decision);
+    decision.frameMs = m_frameMs;
+    decision.overBudget = m_level == (int)m_levels.size() - 1 && m_frameMs > m_options.budgetMs;
+    return decision;
+}
+
+
+my::StageTimes my::QualityGovernor::getStageCosts() const {
+    return m_stageCosts;
+}
+
+
+const std::vector<my::GovernorDecision>& my::QualityGovernor::getLevels() const {
+    return m_levels;
+}
+
+//-------------------Private methods start here-------------------
+
+void my::QualityGovernor::buildLevels(int maxThreads) {
+    GovernorDecision level;
+    level.numThreads = maxThreads;
+    m_levels.push_back(level);
+
+    /*
+    Threads cost no quality but only save core time: with a latency budget, they stay at maxThreads.
+    (maxThreads < 1 is the tflite default, which is not governed)
+    */
+    if (m_options.budgetType == BudgetType::Cpu && maxThreads >= 1) {
+        int minThreads = std::min(std::max(m_options.minThreads, 1), maxThreads);
+        while (level.numThreads > minThreads) {
+            level.numThreads = std::max(level.numThreads / 2, minThreads);
+            m_levels.push_back(level);
+        }
+    }
+
+    while (level.detectInterval < m_options.maxDetectInterval) {
+        level.detectInterval = std::min(level.detectInterval * 2, m_options.maxDetectInterval);
+        m_levels.push_back(level);
+    }
+
+    while (level.irisInterval < m_options.maxIrisInterval) {
+        level.irisInterval = std::min(level.irisInterval * 2, m_options.maxIrisInterval);
+        m_levels.push_back(level);
+    }
+
+    for (int i = 0; i < (int)m_levels.size(); ++i) {
+        m_levels[i].level = i;
+    }
+}
+
+
+float my::QualityGovernor::predictCost(const GovernorDecision& level) const {
+    if (m_levelCosts[level.level] > 0.f)
+        return m_levelCosts[level.level];
+
+    /*
+    Scale the measured cost of the current level by the stage costs at both intervals.
+    Until a thread count ran, its wall time is guessed unchanged: core time follows the threads.
+    */
+    const auto& current = m_levels[m_level];
+    float ms = m_levelCosts[m_level] > 0.f ? m_levelCosts[m_level] : m_frameMs;
+    float currentStageMs = predictStageCost(current);
+    if (currentStageMs > 0.f)
+        ms *= predictStageCost(level) / currentStageMs;
+
+    if (m_options.budgetType == BudgetType::Cpu)
+        ms *= (float)std::max(level.numThreads, 1) / std::max(current.numThreads, 1);
+    return ms;
+}
+
+
+float my::QualityGovernor::predictStageCost(const GovernorDecision& level) const {
+    return m_stageCosts.detectionMs / level.detectInterval + m_stageCosts.landmarkMs +
+        m_stageCosts.irisMs / level.irisInterval;
+}
+
+
+void my::QualityGovernor::applyLevel(int level) {
+    const auto& next = m_levels[level];
+    bool isFirst = m_level < 0;
+
+    /*
+    Rebuilding the interpreters now would lose the outputs of the frame just run
+    */
+    m_pendingThreads = next.numThreads >= 1 && next.numThreads != m_appliedThreads ? next.numThreads : 0;
+
+    /*
+    With a redetect interval of N - 1, the detector runs once every N frames
+    */
+    if (isFirst || next.detectInterval != m_levels[m_level].detectInterval) {
+        if (next.detectInterval > 1)
+            m_pipeline.setTrackingMode(true, next.detectInterval - 1, m_options.minPresence);
+        else
+            m_pipeline.setTrackingMode(false);
+    }
+
+    m_pipeline.setIrisInterval(next.irisInterval);
+
+    m_level = level;
+    m_framesSinceChange = 0;
+}
@@ -0,0 +1,167 @@
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+#include "IrisLandmark.hpp"
+
+namespace my {
+
+    /*
+    What the budget of QualityGovernor limits:
+        Latency: wall time per frame
+        Cpu: core time per frame (CPU time of the whole process between two frames, all threads)
+    */
+    enum class BudgetType {
+        Latency,
+        Cpu
+    };
+
+    /*
+    Settings of QualityGovernor.
+    Attributes:
+        budgetType, budgetMs: time per frame (milliseconds) to stay under
+        maxDetectInterval: the face detector runs at least every maxDetectInterval frames
+        maxIrisInterval: the iris models run at least every maxIrisInterval frames
+        minThreads, maxThreads: interpreter threads of every model (maxThreads <= 0: the threads the
+                                pipeline was built with). Threads only go down with BudgetType::Cpu.
+        minPresence: face presence under which tracking falls back to the detector
+        smoothing: weight of the newest frame in the moving averages of the costs
+        upgradeMargin: quality goes back up only if the better level is predicted under upgradeMargin * budgetMs
+        holdFrames: frames between two decisions, so the averages settle after a change
+    */
+    struct GovernorOptions {
+        BudgetType budgetType = BudgetType::Latency;
+        float budgetMs = 33.f;
+        int maxDetectInterval = 30;
+        int maxIrisInterval = 4;
+        int minThreads = 1;
+        int maxThreads = 0;
+        float minPresence = 0.5f;
+        float smoothing = 0.1f;
+        float upgradeMargin = 0.7f;
+        int holdFrames = 15;
+    };
+
+    /*
+    A quality level chosen by QualityGovernor.
+    Attributes:
+        level: index in the degradation ladder (0: full quality)
+        detectInterval: the face detector runs every detectInterval frames (1: every frame, no tracking)
+        irisInterval: the iris models run every irisInterval frames
+        numThreads: interpreter threads of every model
+        predictedMs: cost per frame of this level (measured once the level ran, else scaled from the current level)
+        frameMs: moving average of the measured cost per frame
+        overBudget: true if the cheapest level is reached and still over budget
+    */
+    struct GovernorDecision {
+        int level = 0;
+        int detectInterval = 1;
+        int irisInterval = 1;
+        int numThreads = 1;
+        float predictedMs = 0.f;
+        float frameMs = 0.f;
+        bool overBudget = false;
+    };
+
+    /*
+    Keep an IrisLandmark pipeline under a time budget per frame by lowering its quality instead of dropping frames.
+    The cost per frame of each level is measured at runtime (moving average while the level is in use). A level that
+    has not run yet is predicted from the current one, scaled with the stage costs (moving averages of StageTimes,
+    per invocation). The governor walks a ladder of levels, from the cheapest quality loss:
+    fewer threads (BudgetType::Cpu only), then a longer face re-detection interval (tracking), then a lower iris update rate.
+    It steps down as soon as the measured cost is over budget and back up one level at a time when the better level
+    is predicted well under budget (see GovernorOptions::upgradeMargin).
+    Thread changes are applied at the start of the next frame (see applyPendingSettings()).
+    The pipeline must not be reconfigured by others while governed.
+    This class is non-copyable.
+    */
+    class QualityGovernor {
+        public:
+            /*
+            pipeline: the governed pipeline, it must outlive this object
+            */
+            QualityGovernor(IrisLandmark& pipeline, const GovernorOptions& options = GovernorOptions());
+            QualityGovernor(const QualityGovernor& other) = delete;
+            QualityGovernor& operator=(const QualityGovernor& other) = delete;
+            ~QualityGovernor() = default;
+
+            /*
+            applyPendingSettings(), run the pipeline on the next frame, then update()
+            */
+            void process(const cv::Mat& frame);
+
+            /*
+            Measure the last runInference() of the pipeline and change its settings if needed
+            (for callers running the pipeline themselves, with applyPendingSettings())
+            */
+            void update();
+
+            /*
+            Apply the thread count chosen by the last update(). With XNNPACK, this rebuilds the interpreters
+            and loses their inputs and outputs: callers running the pipeline themselves call it before loading a frame.
+            */
+            void applyPendingSettings();
+
+            /*
+            The settings in use and the cost measured with them
+            */
+            GovernorDecision getDecision() const;
+
+            /*
+            Moving averages of the cost of one invocation of each stage (milliseconds, wall time)
+            */
+            StageTimes getStageCosts() const;
+
+            /*
+            All levels, from full quality to the cheapest one
+            */
+            const std::vector<GovernorDecision>& getLevels() const;
+
+
+        private:
+            /*
+            Build the degradation ladder from the options
+            */
+            void buildLevels(int maxThreads);
+
+            /*
+            Cost per frame of a level: measured if it already ran, else scaled from the current level
+            */
+            float predictCost(const GovernorDecision& level) const;
+
+            /*
+            Wall time per frame of the stages at the intervals of a level (stages that do not run 
+            every frame cost their share per frame)
+            */
+            float predictStageCost(const GovernorDecision& level) const;
+
+            /*
+            Apply the settings of a level to the pipeline
+            */
+            void applyLevel(int level);
+
+
+        private:
+            IrisLandmark& m_pipeline;
+            GovernorOptions m_options;
+            std::vector<GovernorDecision> m_levels;
+
+            int m_level;
+            int m_framesSinceChange;
+            float m_frameMs;
+            StageTimes m_stageCosts;
+            std::vector<float> m_levelCosts;
+
+            /*
+            Threads: set on the pipeline, and chosen but not applied yet (0: none)
+            */
+            int m_appliedThreads;
+            int m_pendingThreads;
+
+            /*
+            CPU time of the process at the previous update() (BudgetType::Cpu)
+            */
+            double m_lastCpuMs;
+    };
+}
+
+#endif // QUALITYGOVERNOR_H
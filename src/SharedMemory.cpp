@@ -0,0 +1,210 @@
+#include "SharedMemory.hpp"
+
+#include <cerrno>
+#include <climits>
+#include <ctime>
+
+#if defined(_WIN32)
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <semaphore.h>
+    #include <signal.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+#define SHARED_ACCESS_MODE 0660
+
+/*
+Helper function
+*/
+std::string getSystemObjectName(const std::string& name) {
+#if defined(_WIN32)
+    return "Local\\" + name;
+#else
+    return "/" + name;
+#endif
+}
+
+
+my::SharedMemory::SharedMemory(const std::string& name, size_t bytes, bool create):
+    m_name(getSystemObjectName(name)),
+    m_data(nullptr),
+    m_size(0),
+    m_isOwner(create),
+#if defined(_WIN32)
+    m_mappingHandle(nullptr)
+#else
+    m_fd(-1)
+#endif
+{
+#if defined(_WIN32)
+    if (create) {
+        m_mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+            (DWORD)((uint64_t)bytes >> 32), (DWORD)(bytes & 0xFFFFFFFF), m_name.c_str());
+    }
+    else {
+        m_mappingHandle = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, m_name.c_str());
+    }
+    if (m_mappingHandle == nullptr) return;
+
+    m_data = static_cast<uint8_t*>(MapViewOfFile(m_mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, create ? bytes : 0));
+    if (m_data == nullptr) return;
+
+    MEMORY_BASIC_INFORMATION info;
+    m_size = create ? bytes : (VirtualQuery(m_data, &info, sizeof(info)) ? info.RegionSize : 0);
+#else
+    if (create) {
+        /*
+        A region left by a server that crashed is replaced
+        */
+        shm_unlink(m_name.c_str());
+        m_fd = shm_open(m_name.c_str(), O_CREAT | O_EXCL | O_RDWR, SHARED_ACCESS_MODE);
+        if (m_fd >= 0 && ftruncate(m_fd, (off_t)bytes) != 0) {
+            close(m_fd);
+            m_fd = -1;
+        }
+    }
+    else {
+        m_fd = shm_open(m_name.c_str(), O_RDWR, SHARED_ACCESS_MODE);
+    }
+    if (m_fd < 0) return;
+
+    struct stat fileStat;
+    if (fstat(m_fd, &fileStat) != 0 || fileStat.st_size <= 0) return;
+
+    void* data = mmap(nullptr, fileStat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) return;
+
+    m_data = static_cast<uint8_t*>(data);
+    m_size = (size_t)fileStat.st_size;
+#endif
+}
+
+
+my::SharedMemory::~SharedMemory() {
+#if defined(_WIN32)
+    if (m_data != nullptr) UnmapViewOfFile(m_data);
+    if (m_mappingHandle != nullptr) CloseHandle(m_mappingHandle);
+#else
+    if (m_data != nullptr) munmap(m_data, m_size);
+    if (m_fd >= 0) close(m_fd);
+    if (m_isOwner) shm_unlink(m_name.c_str());
+#endif
+}
+
+
+bool my::SharedMemory::isOpened() const {
+    return m_data != nullptr;
+}
+
+
+uint8_t* my::SharedMemory::getData() const {
+    return m_data;
+}
+
+
+size_t my::SharedMemory::getSize() const {
+    return m_size;
+}
+
+
+my::NamedSemaphore::NamedSemaphore(const std::string& name, bool create):
+    m_name(getSystemObjectName(name)),
+    m_isOwner(create),
+    m_handle(nullptr)
+{
+#if defined(_WIN32)
+    if (create)
+        m_handle = CreateSemaphoreA(nullptr, 0, LONG_MAX, m_name.c_str());
+    else
+        m_handle = OpenSemaphoreA(SEMAPHORE_ALL_ACCESS, FALSE, m_name.c_str());
+#else
+    sem_t* semaphore = SEM_FAILED;
+    if (create) {
+        sem_unlink(m_name.c_str());
+        semaphore = sem_open(m_name.c_str(), O_CREAT | O_EXCL, SHARED_ACCESS_MODE, 0);
+    }
+    else {
+        semaphore = sem_open(m_name.c_str(), 0);
+    }
+    if (semaphore != SEM_FAILED) m_handle = semaphore;
+#endif
+}
+
+
+my::NamedSemaphore::~NamedSemaphore() {
+    if (m_handle == nullptr) return;
+#if defined(_WIN32)
+    CloseHandle(m_handle);
+#else
+    sem_close(static_cast<sem_t*>(m_handle));
+    if (m_isOwner) sem_unlink(m_name.c_str());
+#endif
+}
+
+
+bool my::NamedSemaphore::isOpened() const {
+    return m_handle != nullptr;
+}
+
+
+void my::NamedSemaphore::post() {
+#if defined(_WIN32)
+    ReleaseSemaphore(m_handle, 1, nullptr);
+#else
+    sem_post(static_cast<sem_t*>(m_handle));
+#endif
+}
+
+
+bool my::NamedSemaphore::wait(int timeoutMs) {
+#if defined(_WIN32)
+    return WaitForSingleObject(m_handle, (DWORD)timeoutMs) == WAIT_OBJECT_0;
+#else
+    /*
+    sem_timedwait takes an absolute CLOCK_REALTIME deadline
+    */
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutMs / 1000;
+    deadline.tv_nsec += (long)(timeoutMs % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    int status;
+    do {
+        status = sem_timedwait(static_cast<sem_t*>(m_handle), &deadline);
+    } while (status != 0 && errno == EINTR);
+    return status == 0;
+#endif
+}
+
+
+uint32_t my::getCurrentProcessId() {
+#if defined(_WIN32)
+    return (uint32_t)GetCurrentProcessId();
+#else
+    return (uint32_t)getpid();
+#endif
+}
+
+
+bool my::isProcessAlive(uint32_t pid) {
+#if defined(_WIN32)
+    HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)pid);
+    if (process == nullptr) 
+        return GetLastError() == ERROR_ACCESS_DENIED;
+
+    bool isAlive = WaitForSingleObject(process, 0) == WAIT_TIMEOUT;
+    CloseHandle(process);
+    return isAlive;
+#else
+    return kill((pid_t)pid, 0) == 0 || errno == EPERM;
+#endif
+}
@@ -0,0 +1,97 @@
+#ifndef SHAREDMEMORY_H
+#define SHAREDMEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace my {
+
+    /*
+    A named shared memory region, mapped read-write (POSIX shm_open / Windows file mapping).
+    The process creating it removes its name on destruction,
+    processes that opened it keep their mapping until they are destroyed.
+    This class is non-copyable.
+    */
+    class SharedMemory {
+        public:
+            /*
+            name: name of the region (without "/" or "Local\" prefix)
+            bytes: size of the region to create (ignored when opening: the whole region is mapped)
+            create: create the region (zero-filled, replacing a stale one of the same name) or open an existing one
+            */
+            SharedMemory(const std::string& name, size_t bytes, bool create);
+            SharedMemory(const SharedMemory& other) = delete;
+            SharedMemory& operator=(const SharedMemory& other) = delete;
+            ~SharedMemory();
+
+            /*
+            Check if the region is mapped
+            */
+            bool isOpened() const;
+
+            /*
+            Mapped memory and its size in bytes
+            */
+            uint8_t* getData() const;
+            size_t getSize() const;
+
+
+        private:
+            std::string m_name;
+            uint8_t* m_data;
+            size_t m_size;
+            bool m_isOwner;
+#if defined(_WIN32)
+            void* m_mappingHandle;
+#else
+            int m_fd;
+#endif
+    };
+
+    /*
+    A named counting semaphore shared between processes, used to wake the other side of a SharedRing.
+    The process creating it removes its name on destruction.
+    This class is thread-safe and non-copyable.
+    */
+    class NamedSemaphore {
+        public:
+            /*
+            create: create the semaphore (count 0, replacing a stale one of the same name) or open an existing one
+            */
+            NamedSemaphore(const std::string& name, bool create);
+            NamedSemaphore(const NamedSemaphore& other) = delete;
+            NamedSemaphore& operator=(const NamedSemaphore& other) = delete;
+            ~NamedSemaphore();
+
+            bool isOpened() const;
+
+            /*
+            Increment the count, waking one waiter
+            */
+            void post();
+
+            /*
+            Wait until the count is positive and decrement it. Return false after timeoutMs.
+            */
+            bool wait(int timeoutMs);
+
+
+        private:
+            std::string m_name;
+            bool m_isOwner;
+            void* m_handle;
+    };
+
+    /*
+    Id of the calling process
+    */
+    uint32_t getCurrentProcessId();
+
+    /*
+    Check if the process pid still runs (a process of another user counts as running)
+    */
+    bool isProcessAlive(uint32_t pid);
+}
+
+#endif // SHAREDMEMORY_H
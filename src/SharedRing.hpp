@@ -0,0 +1,185 @@
+#ifndef SHAREDRING_H
+#define SHAREDRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+#define SHARED_RING_ALIGNMENT   64
+
+namespace my {
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "SharedRing needs lock-free 64-bit atomics");
+
+    /*
+    Control block at the start of the memory of a SharedRing.
+    Producer and consumer positions are on separate cache lines.
+    */
+    struct SharedRingControl {
+        alignas(SHARED_RING_ALIGNMENT) std::atomic<uint64_t> enqueuePos;
+        alignas(SHARED_RING_ALIGNMENT) std::atomic<uint64_t> dequeuePos;
+        alignas(SHARED_RING_ALIGNMENT) uint32_t capacity;
+        uint32_t slotBytes;
+    };
+
+    /*
+    A lock-free bounded multi-producer multi-consumer ring of fixed-size slots,
+    living in memory that may be shared between processes (it holds no pointer).
+    Each slot carries a sequence number telling whether it is free, written or being read,
+    so payloads are written and read in place, without copy:
+        producer: tryAcquireWrite() -> fill the payload -> publish()
+        consumer: tryAcquireRead() -> use the payload -> release()
+    A slot acquired but never published (or released) blocks the ring at that slot:
+    the consumer can find it with getUnpublishedHead() and skip it with forcePublish().
+    SharedRing itself is only a view: copying it gives another view of the same ring.
+    */
+    class SharedRing {
+        public:
+            SharedRing(): m_control(nullptr), m_slots(nullptr) {}
+
+            /*
+            Bytes of memory needed by a ring of capacity slots of payloadBytes each
+            */
+            static size_t getRequiredBytes(uint32_t capacity, size_t payloadBytes) {
+                return sizeof(SharedRingControl) + (size_t)capacity * getSlotBytes(payloadBytes);
+            }
+
+            /*
+            Format memory (aligned to SHARED_RING_ALIGNMENT, getRequiredBytes() long) as an empty ring.
+            capacity must be a power of 2.
+            */
+            void initialize(void* memory, uint32_t capacity, size_t payloadBytes) {
+                m_control = new (memory) SharedRingControl();
+                m_control->capacity = capacity;
+                m_control->slotBytes = (uint32_t)getSlotBytes(payloadBytes);
+                m_slots = static_cast<uint8_t*>(memory) + sizeof(SharedRingControl);
+
+                for (uint32_t i = 0; i < capacity; ++i) {
+                    new (m_slots + (size_t)i * m_control->slotBytes) std::atomic<uint64_t>(i);
+                }
+                m_control->enqueuePos.store(0, std::memory_order_relaxed);
+                m_control->dequeuePos.store(0, std::memory_order_release);
+            }
+
+            /*
+            View a ring formatted by initialize() (possibly in another process)
+            */
+            void attach(void* memory) {
+                m_control = static_cast<SharedRingControl*>(memory);
+                m_slots = static_cast<uint8_t*>(memory) + sizeof(SharedRingControl);
+            }
+
+            /*
+            Reserve the next free slot. Return its payload, or nullptr if the ring is full.
+            */
+            void* tryAcquireWrite(uint64_t& ticket) {
+                uint64_t pos = m_control->enqueuePos.load(std::memory_order_relaxed);
+                while (true) {
+                    uint64_t sequence = getSequence(pos).load(std::memory_order_acquire);
+                    int64_t diff = (int64_t)(sequence - pos);
+                    if (diff == 0) {
+                        if (m_control->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            ticket = pos;
+                            return getPayload(pos);
+                        }
+                    }
+                    else if (diff < 0) {
+                        return nullptr;
+                    }
+                    else {
+                        pos = m_control->enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            /*
+            Make a slot from tryAcquireWrite() visible to consumers
+            */
+            void publish(uint64_t ticket) {
+                getSequence(ticket).store(ticket + 1, std::memory_order_release);
+            }
+
+            /*
+            Take the oldest published slot. Return its payload, or nullptr if the ring is empty
+            (or if the oldest slot is acquired but not published yet).
+            */
+            void* tryAcquireRead(uint64_t& ticket) {
+                uint64_t pos = m_control->dequeuePos.load(std::memory_order_relaxed);
+                while (true) {
+                    uint64_t sequence = getSequence(pos).load(std::memory_order_acquire);
+                    int64_t diff = (int64_t)(sequence - (pos + 1));
+                    if (diff == 0) {
+                        if (m_control->dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                            ticket = pos;
+                            return getPayload(pos);
+                        }
+                    }
+                    else if (diff < 0) {
+                        return nullptr;
+                    }
+                    else {
+                        pos = m_control->dequeuePos.load(std::memory_order_relaxed);
+                    }
+                }
+            }
+
+            /*
+            Give a slot from tryAcquireRead() back to producers
+            */
+            void release(uint64_t ticket) {
+                getSequence(ticket).store(ticket + m_control->capacity, std::memory_order_release);
+            }
+
+            /*
+            Payload of the oldest slot if a producer acquired it but has not published it yet (nullptr otherwise)
+            */
+            void* getUnpublishedHead(uint64_t& ticket) const {
+                uint64_t pos = m_control->dequeuePos.load(std::memory_order_acquire);
+                if (getSequence(pos).load(std::memory_order_acquire) != pos ||
+                    m_control->enqueuePos.load(std::memory_order_acquire) <= pos)
+                    return nullptr;
+
+                ticket = pos;
+                return getPayload(pos);
+            }
+
+            /*
+            Publish a slot in place of a producer that will never do it (e.g. a process that exited).
+            Return false if the slot was published meanwhile.
+            */
+            bool forcePublish(uint64_t ticket) {
+                uint64_t expected = ticket;
+                return getSequence(ticket).compare_exchange_strong(expected, ticket + 1, std::memory_order_acq_rel);
+            }
+
+            bool isAttached() const { return m_control != nullptr; }
+            uint32_t getCapacity() const { return m_control->capacity; }
+            size_t getPayloadBytes() const { return m_control->slotBytes - SHARED_RING_ALIGNMENT; }
+
+        private:
+            /*
+            A slot is its sequence number, padded to a cache line, then the payload
+            */
+            static size_t getSlotBytes(size_t payloadBytes) {
+                return SHARED_RING_ALIGNMENT + (payloadBytes + SHARED_RING_ALIGNMENT - 1) / SHARED_RING_ALIGNMENT * SHARED_RING_ALIGNMENT;
+            }
+
+            std::atomic<uint64_t>& getSequence(uint64_t pos) const {
+                return *reinterpret_cast<std::atomic<uint64_t>*>(getSlot(pos));
+            }
+
+            uint8_t* getPayload(uint64_t pos) const {
+                return getSlot(pos) + SHARED_RING_ALIGNMENT;
+            }
+
+            uint8_t* getSlot(uint64_t pos) const {
+                return m_slots + (size_t)(pos & (m_control->capacity - 1)) * m_control->slotBytes;
+            }
+
+            SharedRingControl* m_control;
+            uint8_t* m_slots;
+    };
+}
+
+#endif // SHAREDRING_H
@@ -0,0 +1,341 @@
+#include "StreamServer.hpp"
+#include "Metrics.hpp"
+#include <iostream>
+#include <thread>
+#include "opencv2/imgcodecs.hpp"
+
+/*
+Helper function
+*/
+my::StreamServerOptions resolveOptions(my::StreamServerOptions options) {
+    if (options.numThreads <= 0)
+        options.numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    if (options.detectionInterpreters <= 0)
+        options.detectionInterpreters = options.numThreads;
+    if (options.landmarkInterpreters <= 0)
+        options.landmarkInterpreters = options.numThreads;
+    if (options.irisInterpreters <= 0)
+        options.irisInterpreters = options.numThreads;
+    if (options.maxFramesInFlightPerStream <= 0)
+        options.maxFramesInFlightPerStream = 1;
+    if (options.maxFramesInFlight <= 0)
+        options.maxFramesInFlight = 2 * options.numThreads;
+
+    for (auto stage : {&options.interpreters.detection, &options.interpreters.landmark, &options.interpreters.iris}) {
+        if (stage->numThreads == AUTO_THREADS) 
+            stage->numThreads = 1;
+    }
+    if (options.eyeRoiSource == my::EyeRoiSource::PreviousFrame)
+        options.eyeRoiSource = my::EyeRoiSource::Detection;
+    return options;
+}
+
+
+my::FileFrameSource::FileFrameSource(std::string path, long long firstFrame, long long endFrame):
+    m_capture(path),
+    m_position(std::max(firstFrame, 0LL)),
+    m_endFrame(endFrame)
+{
+    if (m_position > 0 && m_capture.isOpened()) 
+        m_capture.set(cv::CAP_PROP_POS_FRAMES, (double)m_position);
+}
+
+
+bool my::FileFrameSource::read(cv::Mat& frame) {
+    if (m_endFrame >= 0 && m_position >= m_endFrame) return false;
+    if (!m_capture.isOpened() || !m_capture.read(frame) || frame.empty()) return false;
+
+    ++m_position;
+    return true;
+}
+
+
+bool my::FileFrameSource::isOpened() const {
+    return m_capture.isOpened();
+}
+
+
+long long my::FileFrameSource::getFrameCount() const {
+    return std::max((long long)m_capture.get(cv::CAP_PROP_FRAME_COUNT), 0LL);
+}
+
+
+my::ImageFolderSource::ImageFolderSource(std::string folder, long long firstFrame, long long endFrame):
+    m_position(std::max(firstFrame, 0LL)),
+    m_endFrame(endFrame),
+    m_unreadableFrames(0)
+{
+    for (auto extension : {"png", "jpg", "jpeg", "bmp"}) {
+        std::vector<std::string> files;
+        cv::glob(folder + "/*." + extension, files);
+        m_files.insert(m_files.end(), files.begin(), files.end());
+    }
+    std::sort(m_files.begin(), m_files.end());
+}
+
+
+bool my::ImageFolderSource::read(cv::Mat& frame) {
+    long long end = m_endFrame >= 0 ? std::min(m_endFrame, getFrameCount()) : getFrameCount();
+    if (m_position >= end) return false;
+
+    const auto& file = m_files[m_position++];
+    frame = cv::imread(file, cv::IMREAD_COLOR);
+    if (frame.empty()) {
+        /*
+        A black frame (no face) keeps the frame indices aligned with the files
+        */
+        m_unreadableFrames++;
+        frame = cv::Mat::zeros(1, 1, CV_8UC3);
+    }
+    return true;
+}
+
+
+long long my::ImageFolderSource::getFrameCount() const {
+    return (long long)m_files.size();
+}
+
+
+long long my::ImageFolderSource::getUnreadableFrames() const {
+    return m_unreadableFrames.load();
+}
+
+
+my::StreamServer::StreamServer(std::string modelPath, StreamServerOptions options):
+    m_options(resolveOptions(options)),
+    m_detectors(m_options.detectionInterpreters, [this, modelPath]() {
+        std::unique_ptr<FaceDetection> detector(new FaceDetection(modelPath, m_options.interpreters.detection, 
+            m_options.interpreters.detectorRange));
+        detector->setPixelFormat(m_options.pixelFormat);
+        return detector;
+    }),
+    m_landmarkers(m_options.landmarkInterpreters, [this, modelPath]() {
+        std::unique_ptr<ModelLoader> landmarker(new ModelLoader(modelPath + "/face_landmark.tflite", m_options.interpreters.landmark));
+        landmarker->setPixelFormat(m_options.pixelFormat);
+        return landmarker;
+    }),
+    m_irisLandmarkers(m_options.irisInterpreters, [this, modelPath]() {
+        std::unique_ptr<ModelLoader> irisLandmarker(new ModelLoader(modelPath + "/iris_landmark.tflite", m_options.interpreters.iris));
+        irisLandmarker->setPixelFormat(m_options.pixelFormat);
+        return irisLandmarker;
+    }),
+    m_inFlight(0),
+    m_framesCompleted(0),
+    m_stopped(false),
+    m_scheduler(m_options.numThreads)
+{}
+
+
+my::StreamServer::~StreamServer() {
+    stop();
+}
+
+
+int my::StreamServer::addStream(std::unique_ptr<FrameSource> source, ResultCallback callback) {
+    std::unique_ptr<Stream> stream(new Stream());
+    stream->id = m_streams.size();
+    stream->source = std::move(source);
+    stream->callback = std::move(callback);
+    stream->exhausted = false;
+    stream->inFlight = 0;
+    stream->nextFrame = 0;
+    stream->nextToDeliver = 0;
+    stream->framesProcessed = 0;
+    stream->framesWithFace = 0;
+
+    m_streams.push_back(std::move(stream));
+    return m_streams.back()->id;
+}
+
+
+void my::StreamServer::run() {
+    while (true) {
+        long long completedBefore;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            completedBefore = m_framesCompleted;
+        }
+        int admitted = admitFrames();
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool allExhausted = std::all_of(m_streams.begin(), m_streams.end(), 
+            [](const std::unique_ptr<Stream>& s) {return s->exhausted;});
+
+        if ((allExhausted || m_stopped) && m_inFlight == 0) 
+            return;
+
+        /*
+        Nothing could be admitted: wait until a frame completes
+        */
+        if (admitted == 0 || allExhausted || m_stopped) {
+            m_frameDone.wait(lock, [this, completedBefore]() {
+                return m_framesCompleted != completedBefore || m_inFlight == 0;
+            });
+        }
+    }
+}
+
+
+void my::StreamServer::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopped = true;
+    }
+    m_frameDone.notify_all();
+}
+
+
+my::StreamStats my::StreamServer::getStreamStats(int streamId) const {
+    auto& stream = *m_streams.at(streamId);
+    return {stream.nextFrame, stream.framesProcessed.load(), stream.framesWithFace.load(),
+        stream.source->getUnreadableFrames()};
+}
+
+//-------------------Private methods start here-------------------
+
+int my::StreamServer::admitFrames() {
+    int admitted = 0;
+
+    for (auto& stream: m_streams) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopped || m_inFlight >= m_options.maxFramesInFlight) break;
+            if (stream->exhausted || stream->inFlight >= m_options.maxFramesInFlightPerStream) continue;
+        }
+
+        JobPtr job(new FrameJob());
+        if (!stream->source->read(job->frame)) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            stream->exhausted = true;
+            continue;
+        }
+
+        job->stream = stream.get();
+        job->index = stream->nextFrame++;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            stream->inFlight++;
+            m_inFlight++;
+        }
+
+        m_scheduler.submit([this, job]() {runDetection(job);});
+        admitted++;
+    }
+    return admitted;
+}
+
+
+void my::StreamServer::runDetection(JobPtr job) {
+    Metrics::setCurrentStream(job->stream->id);
+    job->eyesWithMesh = false;
+    {
+        auto detector = m_detectors.acquire();
+        detector->loadImageToInput(job->frame);
+        detector->runInference();
+        job->result.roi = detector->getFaceRoi();
+
+        /*
+        Eye Rois from the keypoints: the eye jobs do not wait for the mesh
+        */
+        if (m_options.eyeRoiSource == EyeRoiSource::Detection && !detector->getDetections().empty()) {
+            const auto& detection = detector->getDetections()[0];
+            auto imageSize = getImageSize(job->frame, m_options.pixelFormat);
+            job->result.leftEyeRoi = FaceDetection::calculateEyeRoiFromDetection(detection, imageSize, true);
+            job->result.rightEyeRoi = FaceDetection::calculateEyeRoiFromDetection(detection, imageSize, false);
+            job->eyesWithMesh = true;
+        }
+    }
+
+    if (job->result.roi.empty()) {
+        complete(job);
+        return;
+    }
+
+    if (job->eyesWithMesh) {
+        job->jobsPending = 3;
+        m_scheduler.submit([this, job]() {runLandmark(job);});
+        m_scheduler.submit([this, job]() {runEye(job, true);});
+        m_scheduler.submit([this, job]() {runEye(job, false);});
+        return;
+    }
+    m_scheduler.submit([this, job]() {runLandmark(job);});
+}
+
+
+void my::StreamServer::runLandmark(JobPtr job) {
+    Metrics::setCurrentStream(job->stream->id);
+    {
+        auto landmarker = m_landmarkers.acquire();
+        FaceMeshWorker::runFaceLandmark(*landmarker, job->frame, job->result.roi, job->result);
+    }
+
+    if (job->eyesWithMesh) {
+        if (--job->jobsPending == 0) 
+            complete(job);
+        return;
+    }
+
+    if (job->result.faceLandmarks.empty()) {
+        complete(job);
+        return;
+    }
+
+    /*
+    Both eyes run as separate jobs, the last one completes the frame
+    */
+    job->jobsPending = 2;
+    m_scheduler.submit([this, job]() {runEye(job, true);});
+    m_scheduler.submit([this, job]() {runEye(job, false);});
+}
+
+
+void my::StreamServer::runEye(JobPtr job, bool isLeftEye) {
+    Metrics::setCurrentStream(job->stream->id);
+    {
+        auto irisLandmarker = m_irisLandmarkers.acquire();
+        if (job->eyesWithMesh) {
+            auto eyeRoi = isLeftEye ? job->result.leftEyeRoi : job->result.rightEyeRoi;
+            FaceMeshWorker::runEyeLandmark(*irisLandmarker, job->frame, eyeRoi, isLeftEye, job->result);
+        }
+        else {
+            FaceMeshWorker::runEyeLandmark(*irisLandmarker, job->frame, isLeftEye, job->result);
+        }
+    }
+
+    if (--job->jobsPending == 0) {
+        complete(job);
+    }
+}
+
+
+void my::StreamServer::complete(JobPtr job) {
+    auto& stream = *job->stream;
+    stream.framesProcessed++;
+    if (!job->result.faceLandmarks.empty()) 
+        stream.framesWithFace++;
+
+    deliver(stream, job->index, std::move(job->result));
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        stream.inFlight--;
+        m_inFlight--;
+        m_framesCompleted++;
+    }
+    m_frameDone.notify_all();
+}
+
+
+void my::StreamServer::deliver(Stream& stream, long long index, FaceResult result) {
+    std::lock_guard<std::mutex> lock(stream.deliveryMutex);
+    stream.finished[index] = std::move(result);
+
+    auto it = stream.finished.begin();
+    while (it != stream.finished.end() && it->first == stream.nextToDeliver) {
+        if (stream.callback) 
+            stream.callback(stream.id, it->first, it->second);
+
+        it = stream.finished.erase(it);
+        stream.nextToDeliver++;
+    }
+}
@@ -0,0 +1,241 @@
+#ifndef STREAMSERVER_H
+#define STREAMSERVER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "opencv2/videoio.hpp"
+
+#include "FaceDetection.hpp"
+#include "FaceMeshWorker.hpp"
+#include "InterpreterPool.hpp"
+#include "WorkStealingScheduler.hpp"
+
+namespace my {
+
+    /*
+    A source of frames for one stream.
+    read() should not block for long: frames are pulled only when the stream has room.
+    */
+    class FrameSource {
+        public:
+            virtual ~FrameSource() = default;
+
+            /*
+            Read the next frame (in StreamServerOptions::pixelFormat). Return false at the end of the stream.
+            */
+            virtual bool read(cv::Mat& frame) = 0;
+
+            /*
+            Number of frames that could not be decoded so far (read() gave a black frame instead)
+            */
+            virtual long long getUnreadableFrames() const { return 0; }
+    };
+
+    /*
+    Frames from a video file or an image sequence (e.g. "frames/img_%04d.png").
+    Only frames in [firstFrame, endFrame) are read (endFrame < 0: until the end).
+    */
+    class FileFrameSource : public FrameSource {
+        public:
+            FileFrameSource(std::string path, long long firstFrame = 0, long long endFrame = -1);
+            virtual ~FileFrameSource() = default;
+
+            virtual bool read(cv::Mat& frame);
+
+            bool isOpened() const;
+
+            /*
+            Number of frames of the whole file (0 if unknown)
+            */
+            long long getFrameCount() const;
+
+        private:
+            cv::VideoCapture m_capture;
+            long long m_position;
+            long long m_endFrame;
+    };
+
+    /*
+    Frames from the images of a folder (.png, .jpg, .jpeg, .bmp), sorted by file name.
+    An unreadable image gives a black frame, so frame indices always match the files (see getUnreadableFrames()).
+    Only frames in [firstFrame, endFrame) are read (endFrame < 0: until the end).
+    */
+    class ImageFolderSource : public FrameSource {
+        public:
+            ImageFolderSource(std::string folder, long long firstFrame = 0, long long endFrame = -1);
+            virtual ~ImageFolderSource() = default;
+
+            virtual bool read(cv::Mat& frame);
+
+            /*
+            Number of images of the whole folder
+            */
+            long long getFrameCount() const;
+
+            virtual long long getUnreadableFrames() const;
+
+        private:
+            std::vector<std::string> m_files;
+            long long m_position;
+            long long m_endFrame;
+            std::atomic<long long> m_unreadableFrames;
+    };
+
+    /*
+    Settings of StreamServer (0 means automatic).
+    Attributes:
+        numThreads: number of scheduler workers (default: hardware concurrency)
+        detectionInterpreters, landmarkInterpreters, irisInterpreters: pool sizes (default: numThreads)
+        maxFramesInFlightPerStream: frames of one stream being processed at the same time
+        maxFramesInFlight: frames of all streams being processed at the same time (default: 2 x numThreads)
+        interpreters: interpreter settings of each stage (automatic thread counts become 1,
+                      as the scheduler already keeps every core busy)
+        eyeRoiSource: with EyeRoiSource::Detection, the eye jobs start with the landmark job from the
+                      detection keypoints (PreviousFrame is served as Detection: frames of a stream
+                      run concurrently, so the previous mesh is not known yet)
+        pixelFormat: layout of the frames of every source (FileFrameSource and ImageFolderSource read BGR)
+    */
+    struct StreamServerOptions {
+        int numThreads = 0;
+        int detectionInterpreters = 0;
+        int landmarkInterpreters = 0;
+        int irisInterpreters = 0;
+        int maxFramesInFlightPerStream = 2;
+        int maxFramesInFlight = 0;
+        PipelineOptions interpreters;
+        EyeRoiSource eyeRoiSource = EyeRoiSource::FaceMesh;
+        PixelFormat pixelFormat = PixelFormat::BGR;
+    };
+
+    /*
+    Counters of one stream.
+    */
+    struct StreamStats {
+        long long framesRead;
+        long long framesProcessed;
+        long long framesWithFace;
+        long long framesUnreadable;
+    };
+
+    /*
+    Serve many video streams with shared pools of interpreters.
+    Each frame is split into detection, face landmark and two iris jobs that run on a
+    work-stealing scheduler, so the work of all streams is spread across the cores.
+    Streams are admitted round-robin (fairness) and a stream is only read when it has
+    fewer than maxFramesInFlightPerStream frames in flight (backpressure).
+    Results of each stream are delivered in frame order.
+    This class is non-copyable.
+    */
+    class StreamServer {
+        public:
+            /*
+            Called with the stream id, the frame index in the stream and its result.
+            Calls of one stream are serialized, calls of different streams may run in parallel.
+            */
+            typedef std::function<void(int, long long, const FaceResult&)> ResultCallback;
+
+            /*
+            Users MUST provide the FOLDER contain ALL the face_detection_short.tflite, 
+            face_landmark.tflite and iris_landmark.tflite 
+            */
+            StreamServer(std::string modelPath, StreamServerOptions options = StreamServerOptions());
+            StreamServer(const StreamServer& other) = delete;
+            StreamServer& operator=(const StreamServer& other) = delete;
+            ~StreamServer();
+
+            /*
+            Add a stream, return its id. Must be called before run().
+            */
+            int addStream(std::unique_ptr<FrameSource> source, ResultCallback callback);
+
+            /*
+            Process all streams until every source is exhausted (or stop() is called)
+            and all frames in flight are delivered.
+            */
+            void run();
+
+            /*
+            Stop reading new frames (can be called from any thread, e.g. a callback).
+            */
+            void stop();
+
+            StreamStats getStreamStats(int streamId) const;
+
+
+        private:
+            struct Stream {
+                int id;
+                std::unique_ptr<FrameSource> source;
+                ResultCallback callback;
+                bool exhausted;
+                int inFlight;
+                long long nextFrame;
+
+                /*
+                Reorder buffer
+                */
+                std::mutex deliveryMutex;
+                long long nextToDeliver;
+                std::map<long long, FaceResult> finished;
+
+                std::atomic<long long> framesProcessed;
+                std::atomic<long long> framesWithFace;
+            };
+
+            struct FrameJob {
+                Stream* stream;
+                long long index;
+                cv::Mat frame;
+                FaceResult result;
+                bool eyesWithMesh;
+                std::atomic<int> jobsPending;
+            };
+            typedef std::shared_ptr<FrameJob> JobPtr;
+
+            /*
+            Jobs of one frame
+            */
+            void runDetection(JobPtr job);
+            void runLandmark(JobPtr job);
+            void runEye(JobPtr job, bool isLeftEye);
+            void complete(JobPtr job);
+
+            /*
+            Deliver finished frames of stream in order
+            */
+            void deliver(Stream& stream, long long index, FaceResult result);
+
+            /*
+            Read one frame of each stream that has room, return number of frames admitted
+            */
+            int admitFrames();
+
+
+        private:
+            StreamServerOptions m_options;
+
+            InterpreterPool<FaceDetection> m_detectors;
+            InterpreterPool<ModelLoader> m_landmarkers;
+            InterpreterPool<ModelLoader> m_irisLandmarkers;
+
+            std::vector<std::unique_ptr<Stream>> m_streams;
+
+            std::mutex m_mutex;
+            std::condition_variable m_frameDone;
+            int m_inFlight;
+            long long m_framesCompleted;
+            bool m_stopped;
+
+            /*
+            Declared last: its destructor drains the tasks before anything else is destroyed
+            */
+            WorkStealingScheduler m_scheduler;
+    };
+}
+
+#endif // STREAMSERVER_H
@@ -0,0 +1,144 @@
+#include "ThreadPool.hpp"
+
+#if defined(_WIN32)
+    #define NOMINMAX
+    #include <windows.h>
+#elif defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#define INITIAL_QUEUE_SIZE 64
+
+
+my::ThreadPool::ThreadPool(int numThreads, bool pinThreads):
+    m_jobs(INITIAL_QUEUE_SIZE),
+    m_head(0),
+    m_count(0),
+    m_stop(false)
+{
+    if (numThreads <= 0) {
+        numThreads = std::max((int)std::thread::hardware_concurrency() - 1, 1);
+    }
+
+    for (int i = 0; i < numThreads; ++i) {
+        m_threads.emplace_back([this]() {workerLoop();});
+        if (pinThreads) pinToCore(m_threads.back(), i);
+    }
+}
+
+
+my::ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_jobAvailable.notify_all();
+
+    for (auto& t: m_threads) {
+        t.join();
+    }
+}
+
+
+int my::ThreadPool::getNumberOfThreads() const {
+    return m_threads.size();
+}
+
+
+my::ThreadPool& my::ThreadPool::getDefault() {
+    static ThreadPool pool;
+    return pool;
+}
+
+//-------------------Private methods start here-------------------
+
+void my::ThreadPool::push(const Job& job) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_count == m_jobs.size()) {
+            /*
+            Unroll the ring into a bigger buffer
+            */
+            std::vector<Job> jobs(m_jobs.size() * 2);
+            for (size_t i = 0; i < m_count; ++i) {
+                jobs[i] = m_jobs[(m_head + i) % m_jobs.size()];
+            }
+            m_jobs.swap(jobs);
+            m_head = 0;
+        }
+        m_jobs[(m_head + m_count) % m_jobs.size()] = job;
+        m_count++;
+    }
+    m_jobAvailable.notify_one();
+}
+
+
+bool my::ThreadPool::tryPop(Job& job) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_count == 0) return false;
+
+    job = m_jobs[m_head];
+    m_head = (m_head + 1) % m_jobs.size();
+    m_count--;
+    return true;
+}
+
+
+void my::ThreadPool::run(const Job& job) {
+    job.function(job.context, job.index);
+
+    if (job.pending && job.pending->fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobDone.notify_all();
+    }
+}
+
+
+void my::ThreadPool::waitFor(std::atomic<int>& pending) {
+    while (pending.load() > 0) {
+        Job job;
+        if (tryPop(job)) {
+            run(job);
+            continue;
+        }
+
+        /*
+        Nothing left to help with, all our jobs are running on workers
+        */
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_jobDone.wait(lock, [&pending]() {return pending.load() == 0;});
+    }
+}
+
+
+void my::ThreadPool::workerLoop() {
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this]() {return m_stop || m_count > 0;});
+            if (m_count == 0) return;
+
+            job = m_jobs[m_head];
+            m_head = (m_head + 1) % m_jobs.size();
+            m_count--;
+        }
+        run(job);
+    }
+}
+
+
+void my::ThreadPool::pinToCore(std::thread& thread, int core) {
+    int numCores = std::max((int)std::thread::hardware_concurrency(), 1);
+    core %= numCores;
+
+#if defined(_WIN32)
+    SetThreadAffinityMask(thread.native_handle(), DWORD_PTR(1) << core);
+#elif defined(__linux__)
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(core, &cpuset);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpuset);
+#endif
+}
@@ -0,0 +1,123 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace my {
+
+    /*
+    A persistent pool of worker threads for per-frame parallel work.
+    Tasks are queued as plain function pointers, so parallelFor() does not allocate.
+    Threads waiting on their tasks help running queued jobs, so nested calls cannot deadlock.
+    This class is non-copyable.
+    */
+    class ThreadPool {
+        public:
+            /*
+            Parameters:
+                numThreads: number of workers (<= 0: hardware concurrency - 1, at least 1)
+                pinThreads: pin worker i to CPU core i (Windows and Linux only)
+            */
+            ThreadPool(int numThreads = 0, bool pinThreads = false);
+            ThreadPool(const ThreadPool& other) = delete;
+            ThreadPool& operator=(const ThreadPool& other) = delete;
+            ~ThreadPool();
+
+            /*
+            Get number of worker threads.
+            */
+            int getNumberOfThreads() const;
+
+            /*
+            Run task on a worker, the result is available through the returned future.
+            */
+            template <class F>
+            auto submit(F task) -> std::future<decltype(task())> {
+                typedef decltype(task()) R;
+                auto packaged = new std::packaged_task<R()>(std::move(task));
+                auto future = packaged->get_future();
+                push({&ThreadPool::invokeOnce<R>, packaged, 0, nullptr});
+                return future;
+            }
+
+            /*
+            Run body(0) ... body(n - 1) in parallel and wait for all of them.
+            body(0) always runs on the calling thread.
+            */
+            template <class F>
+            void parallelFor(int n, const F& body) {
+                if (n <= 0) return;
+
+                std::atomic<int> pending(n - 1);
+                for (int i = 1; i < n; ++i) {
+                    push({&ThreadPool::invokeAt<F>, (void*)&body, i, &pending});
+                }
+                body(0);
+                waitFor(pending);
+            }
+
+            /*
+            A process-wide pool shared by the pipelines by default.
+            */
+            static ThreadPool& getDefault();
+
+
+        private:
+            /*
+            A queued task: function(context, index), then decrement pending (if any)
+            */
+            struct Job {
+                void (*function)(void* context, int index);
+                void* context;
+                int index;
+                std::atomic<int>* pending;
+            };
+
+            template <class R>
+            static void invokeOnce(void* context, int) {
+                auto task = static_cast<std::packaged_task<R()>*>(context);
+                (*task)();
+                delete task;
+            }
+
+            template <class F>
+            static void invokeAt(void* context, int index) {
+                (*static_cast<const F*>(context))(index);
+            }
+
+            /*
+            Job queue (ring buffer, it only grows)
+            */
+            void push(const Job& job);
+            bool tryPop(Job& job);
+            void run(const Job& job);
+
+            /*
+            Help running queued jobs until pending reaches 0
+            */
+            void waitFor(std::atomic<int>& pending);
+
+            void workerLoop();
+            static void pinToCore(std::thread& thread, int core);
+
+
+        private:
+            std::vector<std::thread> m_threads;
+
+            std::vector<Job> m_jobs;
+            size_t m_head;
+            size_t m_count;
+
+            std::mutex m_mutex;
+            std::condition_variable m_jobAvailable;
+            std::condition_variable m_jobDone;
+            bool m_stop;
+    };
+}
+
+#endif // THREADPOOL_H
@@ -0,0 +1,106 @@
+#include "WorkStealingScheduler.hpp"
+
+/*
+Worker identity of the current thread
+*/
+thread_local const my::WorkStealingScheduler* t_scheduler = nullptr;
+thread_local int t_workerIndex = -1;
+
+
+my::WorkStealingScheduler::WorkStealingScheduler(int numThreads):
+    m_pending(0),
+    m_nextQueue(0),
+    m_stop(false)
+{
+    if (numThreads <= 0) {
+        numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+    }
+
+    for (int i = 0; i < numThreads; ++i) {
+        m_queues.emplace_back(new WorkerQueue());
+    }
+    for (int i = 0; i < numThreads; ++i) {
+        m_threads.emplace_back([this, i]() {workerLoop(i);});
+    }
+}
+
+
+my::WorkStealingScheduler::~WorkStealingScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stop = true;
+    }
+    m_wake.notify_all();
+
+    for (auto& t: m_threads) {
+        t.join();
+    }
+}
+
+
+void my::WorkStealingScheduler::submit(Task task) {
+    int worker = (t_scheduler == this) ? 
+        t_workerIndex : (int)(m_nextQueue++ % m_queues.size());
+
+    {
+        std::lock_guard<std::mutex> lock(m_queues[worker]->mutex);
+        m_queues[worker]->tasks.push_back(std::move(task));
+    }
+    m_pending++;
+
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    m_wake.notify_one();
+}
+
+
+int my::WorkStealingScheduler::getNumberOfThreads() const {
+    return m_threads.size();
+}
+
+//-------------------Private methods start here-------------------
+
+bool my::WorkStealingScheduler::popLocal(int worker, Task& task) {
+    auto& queue = *m_queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+
+bool my::WorkStealingScheduler::steal(int worker, Task& task) {
+    int n = m_queues.size();
+    for (int i = 1; i < n; ++i) {
+        auto& queue = *m_queues[(worker + i) % n];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+
+void my::WorkStealingScheduler::workerLoop(int worker) {
+    t_scheduler = this;
+    t_workerIndex = worker;
+
+    while (true) {
+        Task task;
+        if (popLocal(worker, task) || steal(worker, task)) {
+            m_pending--;
+            task();
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this]() {return m_stop || m_pending.load() > 0;});
+        if (m_stop && m_pending.load() == 0) return;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef WORKSTEALINGSCHEDULER_H
+#define WORKSTEALINGSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace my {
+
+    /*
+    A task scheduler where each worker owns a deque of tasks.
+    Tasks submitted from a worker go to its own deque (run LIFO, cache-friendly),
+    tasks submitted from outside are spread round-robin. 
+    Idle workers steal the oldest tasks of the other workers.
+    This class is non-copyable.
+    */
+    class WorkStealingScheduler {
+        public:
+            typedef std::function<void()> Task;
+
+            /*
+            numThreads <= 0: hardware concurrency
+            */
+            WorkStealingScheduler(int numThreads = 0);
+            WorkStealingScheduler(const WorkStealingScheduler& other) = delete;
+            WorkStealingScheduler& operator=(const WorkStealingScheduler& other) = delete;
+
+            /*
+            Run all remaining tasks, then stop the workers.
+            */
+            ~WorkStealingScheduler();
+
+            void submit(Task task);
+
+            int getNumberOfThreads() const;
+
+
+        private:
+            struct WorkerQueue {
+                std::mutex mutex;
+                std::deque<Task> tasks;
+            };
+
+            bool popLocal(int worker, Task& task);
+            bool steal(int worker, Task& task);
+            void workerLoop(int worker);
+
+
+        private:
+            std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+            std::vector<std::thread> m_threads;
+
+            std::atomic<int> m_pending;
+            std::atomic<unsigned> m_nextQueue;
+
+            std::mutex m_sleepMutex;
+            std::condition_variable m_wake;
+            bool m_stop;
+    };
+}
+
+#endif // WORKSTEALINGSCHEDULER_H
@@ -0,0 +1,251 @@
+#include "StreamServer.hpp"
+#include "LandmarkStream.hpp"
+
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#define FACE_LANDMARKS  468
+#define EYE_LANDMARKS   71
+#define IRIS_LANDMARKS  5
+
+
+/*
+Landmark file of one input
+*/
+struct OutputFile {
+    std::string path;
+    std::ofstream file;
+    std::unique_ptr<my::LandmarkStreamWriter> binaryFile;
+    long long firstFrame = 0;
+    long long framesWritten = 0;
+};
+
+
+/*
+Helper functions
+*/
+std::string getInputName(const std::string& input) {
+    auto path = std::filesystem::path(input).lexically_normal();
+    if (path.filename().empty()) path = path.parent_path();
+    return path.stem().string();
+}
+
+
+/*
+Parse "FIRST:END" (END may be empty: until the end)
+*/
+bool parseRange(const std::string& text, long long& first, long long& end) {
+    auto colon = text.find(':');
+    if (colon == std::string::npos) return false;
+
+    first = std::stoll(text.substr(0, colon));
+    end = colon + 1 < text.size() ? std::stoll(text.substr(colon + 1)) : -1;
+    return first >= 0;
+}
+
+
+/*
+Parse "K/N" with 0 <= K < N
+*/
+bool parseShard(const std::string& text, int& shard, int& numShards) {
+    auto slash = text.find('/');
+    if (slash == std::string::npos) return false;
+
+    shard = std::stoi(text.substr(0, slash));
+    numShards = std::stoi(text.substr(slash + 1));
+    return numShards > 0 && shard >= 0 && shard < numShards;
+}
+
+
+void writeHeader(std::ostream& out) {
+    out << "frame,presence,roi_x,roi_y,roi_w,roi_h";
+    auto writeColumns = [&out](const char* name, int count) {
+        for (int i = 0; i < count; ++i) {
+            out << "," << name << i << "_x," << name << i << "_y";
+        }
+    };
+    writeColumns("face", FACE_LANDMARKS);
+    writeColumns("left_eye", EYE_LANDMARKS);
+    writeColumns("left_iris", IRIS_LANDMARKS);
+    writeColumns("right_eye", EYE_LANDMARKS);
+    writeColumns("right_iris", IRIS_LANDMARKS);
+    out << "\n";
+}
+
+
+/*
+One row per frame, landmarks missing for this frame are left empty
+*/
+void writeRow(std::ostream& out, long long frame, const my::FaceResult& result) {
+    out << frame << "," << result.presence << "," << result.roi.x << "," << result.roi.y
+        << "," << result.roi.width << "," << result.roi.height;
+
+    auto writePoints = [&out](const std::vector<cv::Point>& points, int count) {
+        for (int i = 0; i < count; ++i) {
+            if (i < (int)points.size())
+                out << "," << points[i].x << "," << points[i].y;
+            else
+                out << ",,";
+        }
+    };
+    writePoints(result.faceLandmarks, FACE_LANDMARKS);
+    writePoints(result.leftEyeLandmarks, EYE_LANDMARKS);
+    writePoints(result.leftIrisLandmarks, IRIS_LANDMARKS);
+    writePoints(result.rightEyeLandmarks, EYE_LANDMARKS);
+    writePoints(result.rightIrisLandmarks, IRIS_LANDMARKS);
+    out << "\n";
+}
+
+
+/*
+Process videos and image folders headless, and write the landmarks of every frame to a CSV file per input.
+Frames of every input are spread over the interpreter pools of a StreamServer and written back in order,
+so a single long video uses every core.
+Usage: FaceMeshBatch <model folder> <video or image folder>... --output <folder>
+    [--threads N] [--range FIRST:END] [--shard K/N] [--binary [--fp16] [--delta]]
+--range: only process frames [FIRST, END) of every input
+--shard: split every input in N equal frame ranges and process range K (0-based), one per process/machine
+--binary: write a binary landmark file (.fmls, see LandmarkStream.hpp) instead of CSV, 
+    with fp16 values and/or delta coding. Timestamps of the binary file are the frame numbers.
+Output: <output folder>/<input name>[_<first>-<end>].csv, frame numbers are absolute,
+so the files of all shards can simply be concatenated.
+*/
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <model folder> <video or image folder>... --output <folder>"
+            " [--threads N] [--range FIRST:END] [--shard K/N] [--binary [--fp16] [--delta]]" << std::endl;
+        return 1;
+    }
+
+    std::string modelPath = argv[1];
+    std::vector<std::string> inputs;
+    std::string outputFolder = ".";
+    int numThreads = 0;
+    long long rangeFirst = 0, rangeEnd = -1;
+    int shard = 0, numShards = 1;
+    bool isBinary = false;
+    my::LandmarkStreamOptions binaryOptions;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--output" && hasValue) outputFolder = argv[++i];
+        else if (arg == "--threads" && hasValue) numThreads = std::stoi(argv[++i]);
+        else if (arg == "--binary") isBinary = true;
+        else if (arg == "--fp16") binaryOptions.fp16 = true;
+        else if (arg == "--delta") binaryOptions.deltaCoding = true;
+        else if (arg == "--range" && hasValue) {
+            if (!parseRange(argv[++i], rangeFirst, rangeEnd)) {
+                std::cerr << "Invalid range " << argv[i] << " (expected FIRST:END)" << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--shard" && hasValue) {
+            if (!parseShard(argv[++i], shard, numShards)) {
+                std::cerr << "Invalid shard " << argv[i] << " (expected K/N with K < N)" << std::endl;
+                return 1;
+            }
+        }
+        else inputs.push_back(arg);
+    }
+    std::filesystem::create_directories(outputFolder);
+
+    if (numThreads <= 0)
+        numThreads = std::max((int)std::thread::hardware_concurrency(), 1);
+
+    /*
+    Enough frames of the same input in flight to keep every worker busy
+    */
+    my::StreamServerOptions options;
+    options.numThreads = numThreads;
+    options.maxFramesInFlightPerStream = 2 * numThreads;
+    my::StreamServer server(modelPath, options);
+
+    std::vector<std::unique_ptr<OutputFile>> outputs;
+    for (auto& input: inputs) {
+        bool isFolder = std::filesystem::is_directory(input);
+        long long frameCount = isFolder ? my::ImageFolderSource(input).getFrameCount()
+                                        : my::FileFrameSource(input).getFrameCount();
+
+        long long first = rangeFirst;
+        long long end = rangeEnd >= 0 ? rangeEnd : frameCount;
+        if (numShards > 1) {
+            if (frameCount <= 0) {
+                std::cerr << "Cannot shard " << input << ": unknown number of frames" << std::endl;
+                return 1;
+            }
+            long long length = std::max(end - first, 0LL);
+            end = first + length * (shard + 1) / numShards;
+            first = first + length * shard / numShards;
+        }
+
+        std::unique_ptr<my::FrameSource> source;
+        if (isFolder) {
+            source.reset(new my::ImageFolderSource(input, first, end));
+        }
+        else {
+            std::unique_ptr<my::FileFrameSource> file(new my::FileFrameSource(input, first, end));
+            if (!file->isOpened()) {
+                std::cerr << "Cannot open " << input << std::endl;
+                return 1;
+            }
+            source = std::move(file);
+        }
+
+        std::unique_ptr<OutputFile> output(new OutputFile());
+        std::string suffix = (first > 0 || rangeEnd >= 0 || numShards > 1) ?
+            "_" + std::to_string(first) + "-" + std::to_string(end) : "";
+        std::string extension = isBinary ? ".fmls" : ".csv";
+        output->path = (std::filesystem::path(outputFolder) / (getInputName(input) + suffix + extension)).string();
+        output->firstFrame = first;
+        if (isBinary) {
+            output->binaryFile.reset(new my::LandmarkStreamWriter(output->path, binaryOptions));
+        }
+        else {
+            output->file.open(output->path);
+            if (output->file) writeHeader(output->file);
+        }
+        if (isBinary ? !output->binaryFile->isOpened() : !output->file) {
+            std::cerr << "Cannot write " << output->path << std::endl;
+            return 1;
+        }
+
+        /*
+        Results of one stream come in order and never concurrently
+        */
+        auto outputPtr = output.get();
+        server.addStream(std::move(source), [outputPtr](int, long long index, const my::FaceResult& result) {
+            long long frame = outputPtr->firstFrame + index;
+            if (outputPtr->binaryFile)
+                outputPtr->binaryFile->write(frame, result);
+            else
+                writeRow(outputPtr->file, frame, result);
+            outputPtr->framesWritten++;
+        });
+        outputs.push_back(std::move(output));
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    server.run();
+    auto stop = std::chrono::high_resolution_clock::now();
+    float seconds = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() / 1e6;
+
+    long long total = 0;
+    for (int i = 0; i < (int)outputs.size(); ++i) {
+        outputs[i]->file.close();
+        if (outputs[i]->binaryFile) outputs[i]->binaryFile->close();
+        auto stats = server.getStreamStats(i);
+        total += outputs[i]->framesWritten;
+        std::cout << inputs[i] << " -> " << outputs[i]->path << ": " << outputs[i]->framesWritten
+            << " frames, " << stats.framesWithFace << " with face";
+        if (stats.framesUnreadable > 0)
+            std::cout << ", " << stats.framesUnreadable << " unreadable (written as no face)";
+        std::cout << std::endl;
+    }
+    std::cout << "Total: " << total << " frames in " << seconds << "s ("
+        << total / seconds << " FPS, " << numThreads << " threads)" << std::endl;
+    return 0;
+}
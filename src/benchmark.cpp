@@ -0,0 +1,415 @@
+#include "IrisLandmark.hpp"
+#include "FaceMeshWorker.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/videoio.hpp>
+
+#define FACE_LANDMARKS  468
+#define EYE_LANDMARKS   71
+#define IRIS_LANDMARKS  5
+
+/*
+Count every heap allocation of the process.
+With glibc, the C allocation functions are replaced as well: they also catch OpenCV buffers (cv::fastMalloc),
+the tflite arenas and the C++ allocations (operator new calls malloc). Elsewhere, only operator new is counted.
+*/
+std::atomic<long long> g_allocations(0);
+
+#if defined(__GLIBC__)
+#define COUNT_MALLOC 1
+
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* p, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+
+    void* malloc(size_t size) noexcept {
+        g_allocations++;
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size) noexcept {
+        g_allocations++;
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* p, size_t size) noexcept {
+        g_allocations++;
+        return __libc_realloc(p, size);
+    }
+
+    void* memalign(size_t alignment, size_t size) noexcept {
+        g_allocations++;
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size) noexcept {
+        g_allocations++;
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** p, size_t alignment, size_t size) noexcept {
+        g_allocations++;
+        *p = __libc_memalign(alignment, size);
+        return *p == nullptr ? ENOMEM : 0;
+    }
+}
+#else
+#define COUNT_MALLOC 0
+#endif
+
+void* operator new(size_t size) {
+    if (!COUNT_MALLOC) g_allocations++;
+    void* p = std::malloc(size ? size : 1);
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    size_t align = std::max((size_t)alignment, sizeof(void*));
+#if defined(_WIN32)
+    g_allocations++;
+    void* p = _aligned_malloc(size ? size : 1, align);
+#else
+    if (!COUNT_MALLOC) g_allocations++;
+    void* p = nullptr;
+    if (posix_memalign(&p, align, size ? size : 1) != 0) p = nullptr;
+#endif
+    if (p == nullptr) throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+#if defined(_WIN32)
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void operator delete(void* p, size_t, std::align_val_t alignment) noexcept {
+    operator delete(p, alignment);
+}
+
+
+/*
+Latency samples and allocations of one stage
+*/
+struct StageStats {
+    std::vector<double> samples;
+    long long allocations = 0;
+};
+
+typedef std::map<std::string, StageStats> StageMap;
+
+
+/*
+Helper functions
+*/
+template <class F>
+void measure(StageMap& stages, bool record, const std::string& name, F function) {
+    long long allocations = g_allocations.load();
+    auto start = std::chrono::high_resolution_clock::now();
+    function();
+    auto stop = std::chrono::high_resolution_clock::now();
+    allocations = g_allocations.load() - allocations;
+
+    /*
+    Counted before recording: the samples vector grows here
+    */
+    if (record) {
+        auto& stage = stages[name];
+        stage.samples.push_back(std::chrono::duration<double, std::micro>(stop - start).count());
+        stage.allocations += allocations;
+    }
+}
+
+
+double percentile(std::vector<double> samples, double p) {
+    if (samples.empty()) return 0.;
+    std::sort(samples.begin(), samples.end());
+    size_t index = std::min((size_t)(p * (samples.size() - 1) + 0.5), samples.size() - 1);
+    return samples[index];
+}
+
+
+double mean(const std::vector<double>& samples) {
+    if (samples.empty()) return 0.;
+    double sum = 0.;
+    for (auto s: samples) sum += s;
+    return sum / samples.size();
+}
+
+
+/*
+Read all frames of image files, image folders (png/jpg) and video files
+*/
+std::vector<cv::Mat> loadFrames(const std::vector<std::string>& paths, int maxFrames) {
+    std::vector<cv::Mat> frames;
+    for (auto& path: paths) {
+        std::vector<std::string> files;
+        cv::glob(path + "/*.png", files);
+        std::vector<std::string> jpgs;
+        cv::glob(path + "/*.jpg", jpgs);
+        files.insert(files.end(), jpgs.begin(), jpgs.end());
+        if (files.empty()) files.push_back(path);
+
+        for (auto& file: files) {
+            cv::Mat image = cv::imread(file, cv::IMREAD_COLOR);
+            if (!image.empty()) {
+                frames.push_back(image);
+                continue;
+            }
+
+            cv::VideoCapture capture(file);
+            cv::Mat frame;
+            while (capture.isOpened() && capture.read(frame) && (int)frames.size() < maxFrames) {
+                frames.push_back(frame.clone());
+            }
+        }
+    }
+    if ((int)frames.size() > maxFrames) frames.resize(maxFrames);
+    return frames;
+}
+
+
+/*
+Get a number following "key": inside the object of stage in a JSON written by this tool
+*/
+bool findBaselineValue(const std::string& json, const std::string& stage, const std::string& key, double& value) {
+    auto stagePos = json.find("\"" + stage + "\"");
+    if (stagePos == std::string::npos) return false;
+
+    auto end = json.find('}', stagePos);
+    auto keyPos = json.find("\"" + key + "\"", stagePos);
+    if (keyPos == std::string::npos || keyPos > end) return false;
+
+    auto colon = json.find(':', keyPos);
+    value = std::strtod(json.c_str() + colon + 1, nullptr);
+    return true;
+}
+
+
+std::string toJson(const StageMap& stages, int frames, int iterations, int warmup, double fps) {
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"frames\": " << frames << ",\n";
+    out << "  \"iterations\": " << iterations << ",\n";
+    out << "  \"warmup\": " << warmup << ",\n";
+    out << "  \"throughput_fps\": " << fps << ",\n";
+    out << "  \"stages\": {\n";
+
+    int i = 0;
+    for (auto& stage: stages) {
+        auto& samples = stage.second.samples;
+        out << "    \"" << stage.first << "\": {"
+            << "\"count\": " << samples.size() << ", "
+            << "\"mean_us\": " << mean(samples) << ", "
+            << "\"p50_us\": " << percentile(samples, 0.50) << ", "
+            << "\"p95_us\": " << percentile(samples, 0.95) << ", "
+            << "\"p99_us\": " << percentile(samples, 0.99) << ", "
+            << "\"allocations_per_call\": " << (samples.empty() ? 0. : (double)stage.second.allocations / samples.size())
+            << "}" << (++i < (int)stages.size() ? "," : "") << "\n";
+    }
+    out << "  }\n}\n";
+    return out.str();
+}
+
+
+/*
+Run every stage on its own on the frames (iterations times), plus the whole IrisLandmark pipeline.
+Usage: FaceMeshBenchmark <model folder> <image/folder/video>... 
+    [--iterations N] [--warmup N] [--max-frames N] [--output result.json] 
+    [--baseline baseline.json] [--tolerance 0.10] [--delegate auto|builtin|xnnpack] [--threads N] [--check-allocs]
+--delegate and --threads apply to every interpreter (default: xnnpack, tflite default threads; auto and --threads 0: tuned on this machine)
+--check-allocs: the pipeline must not allocate once warm (needs --warmup >= 1)
+Exit code is 2 when a stage p50 or p95 is slower than the baseline by more than tolerance,
+3 when --check-allocs finds allocations in a steady-state frame.
+*/
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <model folder> <image/folder/video>... [--iterations N] [--warmup N]"
+            " [--max-frames N] [--output result.json] [--baseline baseline.json] [--tolerance 0.10]"
+            " [--delegate auto|builtin|xnnpack] [--threads N] [--check-allocs]" << std::endl;
+        return 1;
+    }
+
+    std::string modelPath = argv[1];
+    std::vector<std::string> inputs;
+    int iterations = 5, warmup = 1, maxFrames = 500;
+    double tolerance = 0.10;
+    std::string outputPath, baselinePath;
+    my::InterpreterOptions interpreterOptions;
+    bool checkAllocations = false;
+
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--iterations" && hasValue) iterations = std::stoi(argv[++i]);
+        else if (arg == "--warmup" && hasValue) warmup = std::stoi(argv[++i]);
+        else if (arg == "--max-frames" && hasValue) maxFrames = std::stoi(argv[++i]);
+        else if (arg == "--output" && hasValue) outputPath = argv[++i];
+        else if (arg == "--baseline" && hasValue) baselinePath = argv[++i];
+        else if (arg == "--tolerance" && hasValue) tolerance = std::stod(argv[++i]);
+        else if (arg == "--threads" && hasValue) interpreterOptions.numThreads = std::stoi(argv[++i]);
+        else if (arg == "--check-allocs") checkAllocations = true;
+        else if (arg == "--delegate" && hasValue) {
+            std::string delegate = argv[++i];
+            if (delegate == "builtin") interpreterOptions.delegate = my::DelegateType::Builtin;
+            else if (delegate == "xnnpack") interpreterOptions.delegate = my::DelegateType::XNNPack;
+            else interpreterOptions.delegate = my::DelegateType::Auto;
+        }
+        else inputs.push_back(arg);
+    }
+
+    auto frames = loadFrames(inputs, maxFrames);
+    if (frames.empty()) {
+        std::cerr << "No frame loaded." << std::endl;
+        return 1;
+    }
+
+    my::PipelineOptions pipelineOptions = {interpreterOptions, interpreterOptions, interpreterOptions};
+    my::ModelLoader detector(modelPath + "/" + my::ShortRangeAnchorConfig::modelFile, interpreterOptions);
+    my::DetectionPostProcess<my::ShortRangeAnchorConfig> postProcessor;
+    my::ModelLoader landmarker(modelPath + "/face_landmark.tflite", interpreterOptions);
+    my::ModelLoader irisLandmarker(modelPath + "/iris_landmark.tflite", interpreterOptions);
+    my::IrisLandmark pipeline(modelPath, false, pipelineOptions);
+
+    /*
+    Landmark buffers of the application, allocated once
+    */
+    std::vector<float> faceBuffer(FACE_LANDMARKS * 3);
+    std::vector<float> leftIrisBuffer(IRIS_LANDMARKS * 3), rightIrisBuffer(IRIS_LANDMARKS * 3);
+
+    StageMap stages;
+    double pipelineSeconds = 0.;
+    int pipelineFrames = 0;
+
+    for (int iteration = 0; iteration < warmup + iterations; ++iteration) {
+        bool record = iteration >= warmup;
+
+        for (auto& frame: frames) {
+            /*
+            Stage by stage
+            */
+            my::Detection detection;
+            measure(stages, record, "detection.preprocess", [&]() {detector.loadImageToInput(frame);});
+            measure(stages, record, "detection.invoke", [&]() {detector.runInference();});
+            measure(stages, record, "detection.postprocess", [&]() {
+                detection = postProcessor.getHighestScoreDetection(detector.getOutputView(0), detector.getOutputView(1));
+            });
+
+            if (detection.classId != -1) {
+                my::FaceResult face;
+                face.roi = my::FaceDetection::calculateRoiFromDetection(detection, frame.size());
+
+                measure(stages, record, "landmark.preprocess", [&]() {landmarker.loadRoiToInput(frame, face.roi);});
+                measure(stages, record, "landmark.invoke", [&]() {landmarker.runInference();});
+                measure(stages, record, "landmark.postprocess", [&]() {
+                    face.faceLandmarks = my::FaceMeshWorker::getLandmarks(landmarker, 0, FACE_LANDMARKS, face.roi);
+                });
+
+                for (int eye = 0; eye < 2; ++eye) {
+                    auto eyeRoi = my::FaceMeshWorker::calculateEyeRoi(face, eye == 0);
+                    if (eyeRoi.empty()) continue;
+
+                    std::vector<cv::Point> eyeLandmarks, irisLandmarks;
+                    measure(stages, record, "iris.preprocess", [&]() {irisLandmarker.loadRoiToInput(frame, eyeRoi);});
+                    measure(stages, record, "iris.invoke", [&]() {irisLandmarker.runInference();});
+                    measure(stages, record, "iris.postprocess", [&]() {
+                        eyeLandmarks = my::FaceMeshWorker::getLandmarks(irisLandmarker, 0, EYE_LANDMARKS, eyeRoi);
+                        irisLandmarks = my::FaceMeshWorker::getLandmarks(irisLandmarker, 1, IRIS_LANDMARKS, eyeRoi);
+                    });
+                }
+            }
+
+            /*
+            End to end, as an application uses it (with the allocation-free landmark getters)
+            */
+            auto start = std::chrono::high_resolution_clock::now();
+            measure(stages, record, "pipeline.total", [&]() {
+                pipeline.loadImageToInput(frame);
+                pipeline.runInference();
+                pipeline.getAllFaceLandmarks(faceBuffer.data());
+                pipeline.getAllEyeLandmarks(true, true, leftIrisBuffer.data());
+                pipeline.getAllEyeLandmarks(false, true, rightIrisBuffer.data());
+            });
+            auto stop = std::chrono::high_resolution_clock::now();
+
+            if (record) {
+                pipelineSeconds += std::chrono::duration<double>(stop - start).count();
+                pipelineFrames++;
+            }
+        }
+    }
+
+    double fps = pipelineSeconds > 0. ? pipelineFrames / pipelineSeconds : 0.;
+    auto json = toJson(stages, frames.size(), iterations, warmup, fps);
+    std::cout << json;
+
+    if (!outputPath.empty()) {
+        std::ofstream(outputPath) << json;
+    }
+
+    if (checkAllocations) {
+        long long allocations = stages["pipeline.total"].allocations;
+        if (allocations > 0) {
+            std::cerr << "ALLOCATIONS pipeline.total: " << allocations << " in " 
+                << stages["pipeline.total"].samples.size() << " steady-state frames" << std::endl;
+            return 3;
+        }
+        std::cerr << "No allocation in steady-state frames" << std::endl;
+    }
+
+    /*
+    Compare with baseline
+    */
+    if (!baselinePath.empty()) {
+        std::ifstream file(baselinePath);
+        if (!file) {
+            std::cerr << "Cannot open baseline " << baselinePath << std::endl;
+            return 1;
+        }
+        std::string baseline((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        bool regressed = false;
+        for (auto& stage: stages) {
+            for (auto key: {"p50_us", "p95_us"}) {
+                double reference;
+                if (!findBaselineValue(baseline, stage.first, key, reference) || reference <= 0.) continue;
+
+                double current = percentile(stage.second.samples, key[1] == '5' ? 0.50 : 0.95);
+                if (current > reference * (1. + tolerance)) {
+                    std::cerr << "REGRESSION " << stage.first << " " << key << ": " 
+                        << current << "us (baseline " << reference << "us)" << std::endl;
+                    regressed = true;
+                }
+            }
+        }
+        if (regressed) return 2;
+        std::cerr << "No regression against " << baselinePath << std::endl;
+    }
+    return 0;
+}
@@ -1,9 +1,11 @@
 #include "IrisLandmark.hpp"
+#include "MultiFaceLandmark.hpp"
 
 #include <iostream>
 #include <opencv2/highgui.hpp>
 
 #define SHOW_FPS    (1)
+#define MULTI_FACE  (0)
 
 #if SHOW_FPS
     #include <chrono>
@@ -12,7 +14,12 @@
 
 int main(int argc, char* argv[]) {
 
-    my::IrisLandmark irisLandmarker("./models");
+    #if MULTI_FACE
+        my::MultiFaceLandmark irisLandmarker("./models");
+    #else
+        my::IrisLandmark irisLandmarker("./models");
+        irisLandmarker.setTrackingMode(true);
+    #endif
     cv::VideoCapture cap(0);
 
     bool success = cap.isOpened();
@@ -44,17 +51,31 @@ int main(int argc, char* argv[]) {
         irisLandmarker.loadImageToInput(rframe);
         irisLandmarker.runInference();
 
-        for (auto landmark: irisLandmarker.getAllFaceLandmarks()) {
-            cv::circle(rframe, landmark, 2, cv::Scalar(0, 255, 0), -1);
-        }       
-
-        for (auto landmark: irisLandmarker.getAllEyeLandmarks(true, true)) {
-            cv::circle(rframe, landmark, 2, cv::Scalar(0, 0, 255), -1);
-        }
-
-        for (auto landmark: irisLandmarker.getAllEyeLandmarks(false, true)) {
-            cv::circle(rframe, landmark, 2, cv::Scalar(0, 0, 255), -1);
-        }
+        #if MULTI_FACE
+            for (auto& face: irisLandmarker.getFaceResults()) {
+                for (auto landmark: face.faceLandmarks) {
+                    cv::circle(rframe, landmark, 2, cv::Scalar(0, 255, 0), -1);
+                }
+                for (auto landmark: face.leftIrisLandmarks) {
+                    cv::circle(rframe, landmark, 2, cv::Scalar(0, 0, 255), -1);
+                }
+                for (auto landmark: face.rightIrisLandmarks) {
+                    cv::circle(rframe, landmark, 2, cv::Scalar(0, 0, 255), -1);
+                }
+            }
+        #else
+            for (auto landmark: irisLandmarker.getAllFaceLandmarks()) {
+                cv::circle(rframe, landmark, 2, cv::Scalar(0, 255, 0), -1);
+            }       
+
+            for (auto landmark: irisLandmarker.getAllEyeLandmarks(true, true)) {
+                cv::circle(rframe, landmark, 2, cv::Scalar(0, 0, 255), -1);
+            }
+
+            for (auto landmark: irisLandmarker.getAllEyeLandmarks(false, true)) {
+                cv::circle(rframe, landmark, 2, cv::Scalar(0, 0, 255), -1);
+            }
+        #endif
 
         #if SHOW_FPS
             auto stop = std::chrono::high_resolution_clock::now();
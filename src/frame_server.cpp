@@ -0,0 +1,73 @@
+#include "FrameServer.hpp"
+
+#include <csignal>
+#include <iostream>
+
+
+/*
+Helper function
+*/
+my::FrameServer* runningServer = nullptr;
+
+void onStopSignal(int) {
+    if (runningServer != nullptr) runningServer->stop();
+}
+
+
+/*
+Serve the processes of this host through shared memory until Ctrl+C (see FrameClient).
+Usage: FaceMeshFrameServer <model folder> [--name N] [--workers N] [--frame-slots N] [--result-slots N] [--max-frame-bytes N] [--full-range]
+--name: name clients connect with (default: facemesh)
+--workers: pipelines running at the same time
+--full-range: detect faces with face_detection_full_range.tflite (far faces, downloaded separately: see README)
+*/
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <model folder> [--name N] [--workers N] [--frame-slots N] [--result-slots N] [--max-frame-bytes N] [--full-range]" << std::endl;
+        return 1;
+    }
+
+    my::FrameServerOptions options;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--name" && i + 1 < argc) {
+            options.name = argv[++i];
+        }
+        else if (arg == "--workers" && i + 1 < argc) {
+            options.numWorkers = std::stoi(argv[++i]);
+        }
+        else if (arg == "--frame-slots" && i + 1 < argc) {
+            options.frameSlots = std::stoi(argv[++i]);
+        }
+        else if (arg == "--result-slots" && i + 1 < argc) {
+            options.resultSlots = std::stoi(argv[++i]);
+        }
+        else if (arg == "--max-frame-bytes" && i + 1 < argc) {
+            options.maxFrameBytes = std::stoull(argv[++i]);
+        }
+        else if (arg == "--full-range") {
+            options.pipeline.detectorRange = my::DetectorRange::Full;
+        }
+        else {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    my::FrameServer server(argv[1], options);
+    if (!server.isOpened())
+        return 1;
+
+    runningServer = &server;
+    std::signal(SIGINT, onStopSignal);
+    std::signal(SIGTERM, onStopSignal);
+
+    std::cout << "Serving " << options.name << " with " << options.numWorkers << " worker(s)" << std::endl;
+    server.run();
+    runningServer = nullptr;
+
+    auto stats = server.getStats();
+    std::cout << stats.framesProcessed << " frames, " << stats.invalidFrames << " invalid, "
+        << stats.droppedResults << " results dropped, " << stats.reclaimedClients << " crashed clients reclaimed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "StreamServer.hpp"
+#include "Metrics.hpp"
+
+#include <chrono>
+#include <iostream>
+
+
+/*
+Run every video file given on the command line as a separate stream
+and report per-stream and total throughput.
+Usage: FaceMeshStreamServer <model folder> <video 1> [<video 2> ...] [--threads N] [--metrics <file>] [--eyes-from-detection] [--full-range]
+--metrics: write per-stage/per-stream latencies (Prometheus format) to file every second
+--eyes-from-detection: take the eye Rois from the detection keypoints, so the iris jobs run with the face mesh
+--full-range: detect faces with face_detection_full_range.tflite (far faces, downloaded separately: see README)
+*/
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <model folder> <video 1> [<video 2> ...] [--threads N] [--metrics <file>] [--eyes-from-detection] [--full-range]" << std::endl;
+        return 1;
+    }
+
+    my::StreamServerOptions options;
+    std::vector<std::string> paths;
+    std::string metricsPath;
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            options.numThreads = std::stoi(argv[++i]);
+        }
+        else if (arg == "--metrics" && i + 1 < argc) {
+            metricsPath = argv[++i];
+        }
+        else if (arg == "--eyes-from-detection") {
+            options.eyeRoiSource = my::EyeRoiSource::Detection;
+        }
+        else if (arg == "--full-range") {
+            options.interpreters.detectorRange = my::DetectorRange::Full;
+        }
+        else {
+            paths.push_back(arg);
+        }
+    }
+
+    my::StreamServer server(argv[1], options);
+
+    for (auto& path: paths) {
+        std::unique_ptr<my::FileFrameSource> source(new my::FileFrameSource(path));
+        if (!source->isOpened()) {
+            std::cerr << "Cannot open " << path << std::endl;
+            return 1;
+        }
+        server.addStream(std::move(source), nullptr);
+    }
+
+    if (!metricsPath.empty()) {
+        my::Metrics::getInstance().setEnabled(true);
+        my::Metrics::getInstance().startPeriodicDump(metricsPath, 1000);
+    }
+
+    auto start = std::chrono::high_resolution_clock::now();
+    server.run();
+    auto stop = std::chrono::high_resolution_clock::now();
+    float seconds = std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count() / 1e6;
+
+    long long total = 0;
+    for (size_t i = 0; i < paths.size(); ++i) {
+        auto stats = server.getStreamStats((int)i);
+        total += stats.framesProcessed;
+        std::cout << "Stream " << i << " (" << paths[i] << "): " << stats.framesProcessed 
+            << " frames, " << stats.framesWithFace << " with face" << std::endl;
+    }
+    std::cout << "Total: " << total << " frames in " << seconds << "s (" 
+        << total / seconds << " FPS)" << std::endl;
+
+    if (!metricsPath.empty()) {
+        my::Metrics::getInstance().stopPeriodicDump();
+        std::cout << my::Metrics::getInstance().toText();
+    }
+    return 0;
+}